@@ -29,7 +29,8 @@ namespace mtInternalUtils
 		void wait()
 		{
 			stdUniqueLock lock(m_mutex);
-			if (!m_signalled)
+			//A notify_one() made right after an earlier signal was consumed without waiting can wake us without a signal
+			while (!m_signalled)
 				m_cond.wait(lock);
 			m_signalled = false;
 		}
@@ -44,8 +45,7 @@ namespace mtInternalUtils
 		void wait_until(const time_point& time)
 		{
 			stdUniqueLock lock(m_mutex);
-			if (!m_signalled)
-				m_cond.wait_until(lock, time);
+			m_cond.wait_until(lock, time, [this]() { return m_signalled; });
 			m_signalled = false;
 		}
 
@@ -60,8 +60,7 @@ namespace mtInternalUtils
 		void wait_for(const duration& duration)
 		{
 			stdUniqueLock lock(m_mutex);
-			if (!m_signalled)
-				m_cond.wait_for(lock, duration);
+			m_cond.wait_for(lock, duration, [this]() { return m_signalled; });
 			m_signalled = false;
 		}
 
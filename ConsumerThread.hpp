@@ -7,10 +7,18 @@
 #include <chrono>
 #include <thread>
 #include <memory>
-#include <CommonUtils/RingBuffer.hpp>
-#include "ConditionVariable.hpp"
-
-typedef std::function<void()> Task;
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <span>
+#include "Event.hpp"
+#include "MPSCQueue.hpp"
+#include "RateLimiter.hpp"
+#include "Task.hpp"
+#include "Thread.hpp"
+#include "TimerFd.hpp"
+#include "TimerQueue.hpp"
+#include "WaitStrategy.hpp"
 
 
 namespace ULMTTools {
@@ -21,7 +29,36 @@ class TaskScheduler;
 
 namespace mtInternalUtils
 {
-	//Keep the template parameter as something assignable and copyable, otherwise results may be underministic
+	//Storage used by FifoConsumerThread to hand over items from producers to the consumer
+	enum class QueueBackend
+	{
+		LockedVector,//vector guarded by a mutex, swapped out in one go by the consumer
+		LockFree//MPSCQueue, producers never block each other or the consumer
+	};
+
+	//What a push does when a bounded FifoConsumerThread is full
+	enum class OverflowPolicy
+	{
+		Block,//push() waits for the consumer to make room
+		Reject,//push() throws
+		DropNewest,//the item being pushed is discarded
+		DropOldest//the oldest pending item is discarded right away to make room for the new one, QueueBackend::LockedVector only
+	};
+
+	struct ConsumerOptions
+	{
+		QueueBackend backend = QueueBackend::LockedVector;
+		size_t capacity = 0;//Max no. of pending items, 0 means unbounded
+		OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+		//onHighWatermark is invoked on the pushing thread with the no. of pending items whenever a push takes that no. to highWatermark or above,
+		//it fires again only after the no. of pending items has gone below highWatermark in between, 0 disables it
+		size_t highWatermark = 0;
+		std::function<void(size_t)> onHighWatermark = nullptr;
+		WaitStrategy waitStrategy = WaitStrategy::Blocking;
+		duration spinDuration = std::chrono::microseconds(50);//How long SpinThenPark spins before going to sleep
+	};
+
+	//Keep the template parameter as something movable, otherwise results may be underministic
 	template <class T>
 	class FifoConsumerThread
 	{
@@ -32,33 +69,61 @@ namespace mtInternalUtils
 
 		
 	private:
+		const ConsumerOptions m_options;
 		ConsumerQueue m_queue;
+		MPSCQueue<T> m_lockFreeQueue;
+		//Includes the items the consumer has taken out of the queue but not processed yet, for the lock free backend
+		//it also tells the consumer about producers which are in the middle of a push
+		std::atomic<size_t> m_numPending;
+		size_t m_numEvicted;//Moved-from items at the front of m_queue, dropped by OverflowPolicy::DropOldest, guarded by m_mutex
+		std::atomic<size_t> m_numDropped;
+		std::atomic<size_t> m_numBlockedProducers;
+		stdMutex m_roomMutex;
+		stdConditionVariable m_roomCond;//Producers blocked on a full queue wait on it
+		std::atomic<bool> m_consumerIdle;//Lock free counterpart of m_consumerBusy
 		stdMutex m_mutex;
-		ConditionVariable m_cond;
+		Event m_cond;
 		std::atomic<bool> m_terminate;
 		bool m_consumerBusy;//Used to avoid unnecessary signalling of consumer if it is busy processing the queue, purely performance
-		stdThread m_thread;
-		std::function<void(T)> m_processor;
+		Thread m_thread;
+		std::function<void(T&&)> m_processor;
+
+		bool lockFree() const
+		{
+			return QueueBackend::LockFree == m_options.backend;
+		}
 
 		void run()
 		{
+			if (lockFree())
+			{
+				runLockFree();
+				return;
+			}
+
 			while (!m_terminate)
 			{
 				ConsumerQueue local;
 
+				size_t numEvicted = 0;
+
+				//Everything taken out earlier has been processed by now, so any pending item has to be in m_queue
+				spinUntil(m_options.waitStrategy, m_options.spinDuration, [this]() { return 0 != m_numPending || m_terminate; });
+
 				{
 					stdUniqueLock lock(m_mutex);
-					if (m_queue.empty())
+					//A busy polling consumer never declares itself idle, so the producers never have to signal it
+					if (m_queue.size() == m_numEvicted && WaitStrategy::BusyPoll != m_options.waitStrategy)
 					{
 						m_consumerBusy = false;
 						m_cond.wait(lock);
 					}
 
-					local.swap(m_queue);
+					numEvicted = takeQueue(local);
 					m_consumerBusy = true;
 				}
 
-				for(auto const& task : local) m_processor(task);
+				for (auto it = local.begin() + numEvicted; it != local.end(); ++it) process(*it);
 			}
 
 			//If the consumer is killed or destroyed, it should exit only after completing the pending tasks
@@ -69,11 +134,209 @@ namespace mtInternalUtils
 				if (!m_queue.empty())
 				{
 					ConsumerQueue local;
-					m_queue.swap(local);
+					size_t numEvicted = takeQueue(local);
+					lock.unlock();
+					for (auto it = local.begin() + numEvicted; it != local.end(); ++it) process(*it);
+				}
+			}
+		}
+
+		//Swaps the pending items out of m_queue, m_mutex held, and returns the no. of evicted ones at the front of 'local' to skip
+		size_t takeQueue(ConsumerQueue& local)
+		{
+			local.swap(m_queue);
+			size_t numEvicted = m_numEvicted;
+			m_numEvicted = 0;
+			return numEvicted;
+		}
+
+		void process(T& item)
+		{
+			m_processor(std::move(item));
+
+			m_numPending.fetch_sub(1);
+			if (m_numBlockedProducers)
+			{
+				stdUniqueLock lock(m_roomMutex);
+				m_roomCond.notify_all();
+			}
+		}
+
+		size_t consumeLockFree()
+		{
+			return m_lockFreeQueue.consume([this](T& item) { process(item); });
+		}
+
+		void runLockFree()
+		{
+			while (!m_terminate)
+			{
+				if (consumeLockFree())
+					continue;
+
+				if (spinUntil(m_options.waitStrategy, m_options.spinDuration, [this]() { return !m_lockFreeQueue.empty() || m_terminate; }) ||
+					WaitStrategy::BusyPoll == m_options.waitStrategy)
+					continue;
+
+				//Announce that we are going to sleep and then look at the queue once more, a producer either sees
+				//the announcement and signals us or its item is visible to the second look, never neither
+				m_consumerIdle = true;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (m_lockFreeQueue.empty() && !m_terminate)
+					m_cond.wait();
+				m_consumerIdle = false;
+			}
+
+			//Same drain-on-kill guarantee as the locked backend, m_numPending also accounts for the producers
+			//that got past the m_terminate check but haven't linked their item yet, so wait for them as well
+			while (0 != m_numPending)
+			{
+				if (!consumeLockFree())
+					std::this_thread::yield();
+			}
+		}
+
+		//Makes room for 'numItems' more pending items as per the overflow policy and returns how many of them may be queued
+		//'nonBlocking' makes the Block and Reject policies return 0 instead of waiting or throwing
+		//Reserving before looking at m_terminate is what lets the lock free consumer wait for us while draining
+		size_t reserve(size_t numItems, bool nonBlocking)
+		{
+			if (!m_options.capacity || OverflowPolicy::DropOldest == m_options.overflowPolicy)
+			{
+				onReserved(m_numPending.fetch_add(numItems), numItems);
+				return numItems;
+			}
+
+			bool partial = OverflowPolicy::DropNewest == m_options.overflowPolicy;
+			size_t numAccepted = tryReserve(numItems, partial);
+			if (numAccepted || partial)
+			{
+				m_numDropped.fetch_add(numItems - numAccepted);
+				return numAccepted;
+			}
+
+			if (nonBlocking)
+				return 0;
+			else if (numItems > m_options.capacity)
+				throw std::invalid_argument("The no. of items pushed at once exceeds the capacity of the consumer");
+			else if (OverflowPolicy::Reject == m_options.overflowPolicy)
+				throw std::runtime_error("The consumer is full");
+
+			stdUniqueLock lock(m_roomMutex);
+			m_numBlockedProducers++;
+			while (!m_terminate && !tryReserve(numItems, false))
+				m_roomCond.wait(lock);
+			m_numBlockedProducers--;
+
+			if (m_terminate)
+				throw std::runtime_error("The consumer has been killed and is no longer in a state to process new items");
+
+			return numItems;
+		}
+
+		size_t tryReserve(size_t numItems, bool partial)
+		{
+			size_t numPending = m_numPending.load();
+			while (true)
+			{
+				size_t room = numPending < m_options.capacity ? m_options.capacity - numPending : 0;
+				size_t numAccepted = partial ? std::min(room, numItems) : (room >= numItems ? numItems : 0);
+				if (!numAccepted)
+					return 0;
+
+				if (m_numPending.compare_exchange_weak(numPending, numPending + numAccepted))
+				{
+					onReserved(numPending, numAccepted);
+					return numAccepted;
+				}
+			}
+		}
+
+		void onReserved(size_t numPendingBefore, size_t numItems)
+		{
+			size_t numPendingAfter = numPendingBefore + numItems;
+			if (m_options.highWatermark &&
+				m_options.onHighWatermark &&
+				numPendingBefore < m_options.highWatermark &&
+				numPendingAfter >= m_options.highWatermark)
+				m_options.onHighWatermark(numPendingAfter);
+		}
+
+		//OverflowPolicy::DropOldest, called with m_mutex held once the new items are in m_queue
+		//Moves the items beyond the capacity out of the front of m_queue into 'evicted', to be destroyed after the lock is
+		//released, down to the new items themselves if the consumer has already taken out all the older ones
+		//A producer whose items are not in m_queue yet leaves the eviction of its share to itself
+		void evictOldest(ConsumerQueue& evicted)
+		{
+			if (!m_options.capacity || OverflowPolicy::DropOldest != m_options.overflowPolicy)
+				return;
+
+			size_t numPending = m_numPending.load();
+			size_t numExcess = numPending > m_options.capacity ? std::min(numPending - m_options.capacity, m_queue.size() - m_numEvicted) : 0;
+			if (!numExcess)
+				return;
+
+			auto first = m_queue.begin() + m_numEvicted;
+			evicted.insert(evicted.end(), std::make_move_iterator(first), std::make_move_iterator(first + numExcess));
+			m_numEvicted += numExcess;
+			m_numPending.fetch_sub(numExcess);
+			m_numDropped.fetch_add(numExcess);
+
+			//Erasing only once the moved-from items are half of the queue keeps the evictions amortized O(1)
+			//while not letting them pile up behind a stalled consumer
+			if (m_numEvicted * 2 >= m_queue.size())
+			{
+				m_queue.erase(m_queue.begin(), m_queue.begin() + m_numEvicted);
+				m_numEvicted = 0;
+			}
+		}
+
+		void cancelReservation(size_t numItems)
+		{
+			m_numPending.fetch_sub(numItems);
+			throw std::runtime_error("The consumer has been killed and is no longer in a state to process new items");
+		}
+
+		template <class... Args>
+		bool emplaceImpl(bool nonBlocking, Args&&... args)
+		{
+			if (!reserve(1, nonBlocking))
+				return false;
+
+			if (lockFree())
+			{
+				if (m_terminate)
+					cancelReservation(1);
+
+				m_lockFreeQueue.emplace(std::forward<Args>(args)...);
+				notifyIfIdle();
+				return true;
+			}
+
+			{
+				ConsumerQueue evicted;
+				stdUniqueLock lock(m_mutex);
+				if (m_terminate)
+					cancelReservation(1);
+				m_queue.emplace_back(std::forward<Args>(args)...);
+				evictOldest(evicted);
+
+				if (!m_consumerBusy)
+				{
 					lock.unlock();
-					for(auto const& task : local) m_processor(task);
+					m_cond.notify_one();
 				}
 			}
+
+			return true;
+		}
+
+		void notifyIfIdle()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			//Only one of the racing producers gets to signal the consumer
+			if (m_consumerIdle.load(std::memory_order_relaxed) && m_consumerIdle.exchange(false))
+				m_cond.notify_one();
 		}
 
 		void kill()
@@ -84,26 +347,94 @@ namespace mtInternalUtils
 				m_terminate = true;
 				lock.unlock();
 				m_cond.notify_one();
+
+				{
+					//Producers blocked on a full queue would otherwise wait forever
+					stdUniqueLock roomLock(m_roomMutex);
+					m_roomCond.notify_all();
+				}
+
 				m_thread.join();
 			}
 		}
 
 	public:
-		FifoConsumerThread(std::function<void(T)> predicate)
-			:m_processor(predicate)
+		FifoConsumerThread(std::function<void(T&&)> predicate,
+			const ConsumerOptions& options = ConsumerOptions(),
+			const ThreadOptions& threadOptions = ThreadOptions())
+			:m_options(options),
+			m_processor(std::move(predicate))
 		{
+			//Only the consumer can take items out of the lock free queue, so producers couldn't make room in it
+			if (QueueBackend::LockFree == m_options.backend && m_options.capacity && OverflowPolicy::DropOldest == m_options.overflowPolicy)
+				throw std::invalid_argument("OverflowPolicy::DropOldest needs QueueBackend::LockedVector");
+
+			m_numPending = 0;
+			m_numEvicted = 0;
+			m_numDropped = 0;
+			m_numBlockedProducers = 0;
+			m_consumerIdle = false;
 			m_terminate = false;
 			m_consumerBusy = false;
-			m_thread = stdThread(&FifoConsumerThread::run, this);
+			m_thread = Thread(threadOptions, [this]() { run(); });
 		}
 
 		void push(const T& item)
 		{
+			emplace(item);
+		}
+
+		void push(T&& item)
+		{
+			emplace(std::move(item));
+		}
+
+		//Constructs the item in place in the queue, so it is only ever moved from there on until it is processed
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			emplaceImpl(false, std::forward<Args>(args)...);
+		}
+
+		//Same as push() but never blocks or throws because the queue is full, returns false if the item wasn't queued
+		bool try_push(T&& item)
+		{
+			return emplaceImpl(true, std::move(item));
+		}
+
+		//Moves all the items in [first, last) into the queue under a single lock acquisition
+		//and wakes up the consumer at most once, the items are processed in the order of the range
+		//On a bounded consumer the overflow policy applies to the batch as a whole, except for DropNewest which
+		//queues as many items from the front of the batch as there is room for
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			size_t numItems = std::distance(first, last);
+			if (!numItems)
+				return;
+
+			numItems = reserve(numItems, false);
+			if (!numItems)
+				return;
+			last = std::next(first, numItems);
+
+			if (lockFree())
 			{
+				if (m_terminate)
+					cancelReservation(numItems);
+
+				m_lockFreeQueue.pushRange(first, last);
+				notifyIfIdle();
+				return;
+			}
+
+			{
+				ConsumerQueue evicted;
 				stdUniqueLock lock(m_mutex);
 				if (m_terminate)
-					throw std::runtime_error("The consumer has been killed and is no longer in a state to process new items");
-				m_queue.push_back(item);
+					cancelReservation(numItems);
+				m_queue.insert(m_queue.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+				evictOldest(evicted);
 
 				if (!m_consumerBusy)
 				{
@@ -111,14 +442,23 @@ namespace mtInternalUtils
 					m_cond.notify_one();
 				}
 			}
+		}
 
+		void push_bulk(std::span<T> items)
+		{
+			push_bulk(items.begin(), items.end());
 		}
 
 		//returns number of pending items
 		size_t size()
 		{
-			stdUniqueLock lock(m_mutex);
-			return m_queue.size();
+			return m_numPending;
+		}
+
+		//returns number of items discarded because of the overflow policy
+		size_t numDropped()
+		{
+			return m_numDropped;
 		}
 
 		~FifoConsumerThread()
@@ -127,22 +467,41 @@ namespace mtInternalUtils
 		}
 	};
 
+	//Items are handed to the scheduler thread in nodes from a pool, the TimerHandle returned by push() referring to the node
+	//A cancelled node is taken out of the TimerQueue at the scheduler thread's next wakeup when the backend can do so in O(1)
+	//(TimerBackend::TimingWheel), otherwise only its item is destroyed then and the node is dropped when its time comes
+	//With SchedulerOptions::externalLoop there is no scheduler thread, the one calling poll() plays its part
 	template <class T>
-	class Scheduler
+	class Scheduler : public TimerCanceller
 	{
-	protected:
-		typedef std::pair<time_point, T> TimeItemPair;
-		typedef std::vector<TimeItemPair> ConsumerQueue;
-		DEFINE_PTR(ConsumerQueue)
+		typedef TimerNode<T> Node;
 
-	private:
-		ConsumerQueue m_itemQueue;
 		stdMutex m_mutex;
-		ConditionVariable m_cond;
-		std::map<time_point, std::vector<T>> m_processingQueue;
+		Event m_cond;
+		std::unique_ptr<TimerFd> m_timerFd;//SchedulerWakeup::TimerFd, m_cond isn't used then
+		const bool m_externalLoop;
+		//Guarded by m_mutex
+		TimerNodePool<T> m_pool;
+		std::vector<Node*> m_incoming;
+		std::vector<Node*> m_cancelled;
+		//Only touched by the scheduler thread
+		TimerQueue<T> m_processingQueue;
+		std::vector<Node*> m_freed;//Given back to m_pool the next time the scheduler thread takes m_mutex
+		//Swapped with m_incoming and m_cancelled, so both pairs keep their capacity and the loop doesn't allocate
+		std::vector<Node*> m_swapIncoming;
+		std::vector<Node*> m_swapCancelled;
+		std::atomic<size_t> m_numCancelledResident;
+		//Written by the scheduler thread only
+		std::atomic<uint64_t> m_numWakeups;
+		std::atomic<uint64_t> m_numFiringWakeups;
+		std::atomic<uint64_t> m_numFired;
+		std::atomic<uint64_t> m_maxFiredPerWakeup;
+		uint64_t m_randomState;//PeriodicOptions::jitter, scheduler thread only
+		const duration m_slack;
 		std::atomic<bool> m_terminate;
-		stdThread m_thread;
-		std::function<void(T)> m_processor;
+		Thread m_thread;
+		std::function<void(T&&)> m_processor;
+		std::function<void(T&)> m_periodicProcessor;//Gets the item kept in the node, which is neither moved nor copied per run
 
 		void kill()
 		{
@@ -151,65 +510,387 @@ namespace mtInternalUtils
 			{
 				m_terminate = true;
 				lock.unlock();//Ugly but necessary
-				m_cond.notify_all();
-				m_thread.join();
+				wake();//Only the scheduler thread ever waits on it
+				if (m_thread.joinable())
+					m_thread.join();
+			}
+		}
+
+		void wake()
+		{
+			if (m_timerFd)
+				m_timerFd->notify();
+			else
+				m_cond.notify_one();
+		}
+
+		//Bumps the generation so that no handle to this use of the node can cancel the next one
+		void freeNode(Node* node)
+		{
+			node->m_item.reset();
+			uint64_t stamp = node->m_stamp.load();
+			if (TimerEntry::Cancelled == (stamp & TimerEntry::stateMask))
+				m_numCancelledResident--;
+
+			node->m_stamp = TimerEntry::stamp((stamp >> TimerEntry::stateBits) + 1, TimerEntry::Free);
+			node->m_detached = false;
+			node->m_cancelSeen = false;
+			m_freed.push_back(node);
+		}
+
+		void onCancelled(Node* node)
+		{
+			//Already out of the queue, its time having come before the cancellation got here
+			if (node->m_detached || m_processingQueue.remove(node))
+				freeNode(node);
+			else
+			{
+				node->m_item.reset();
+				node->m_cancelSeen = true;
 			}
 		}
 
+		void countFired()
+		{
+			m_numFired.store(m_numFired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		void onDue(Node* node)
+		{
+			uint64_t generation = node->generation();
+			if (!node->leavePending(generation, TimerEntry::Fired))
+			{
+				if (node->m_cancelSeen)
+					freeNode(node);
+				else
+					node->m_detached = true;//Cancelled, but the node is still on its way through m_cancelled
+				return;
+			}
+
+			countFired();
+			if (!node->m_periodic.load(std::memory_order_relaxed))
+			{
+				m_processor(std::move(*node->m_item));
+				freeNode(node);
+				return;
+			}
+
+			time_point started = ULCommonUtils::now();
+			m_periodicProcessor(*node->m_item);
+			if (node->rearm(generation))
+			{
+				reschedule(node, started);
+				m_processingQueue.insert(node);
+			}
+			else
+				node->m_detached = true;//Cancelled during the run
+		}
+
+		//Moves a periodic node, which has just run, to its next tick as per its OverrunPolicy
+		void reschedule(Node* node, const time_point& started)
+		{
+			uint64_t numMissed = 0;
+			switch (node->m_overrun)
+			{
+			case OverrunPolicy::CatchUp:
+				node->m_nominal += node->m_period;
+				if (started >= node->m_nominal)
+					numMissed = 1;
+				break;
+
+			case OverrunPolicy::Skip:
+			{
+				node->m_nominal += node->m_period;
+				time_point now = ULCommonUtils::now();
+				if (node->m_nominal <= now)
+				{
+					numMissed = static_cast<uint64_t>((now - node->m_nominal) / node->m_period) + 1;
+					node->m_nominal += node->m_period * static_cast<int64_t>(numMissed);
+				}
+				break;
+			}
+
+			case OverrunPolicy::FixedDelay:
+				if (started > node->m_nominal)
+					numMissed = static_cast<uint64_t>((started - node->m_nominal) / node->m_period);
+				node->m_nominal = ULCommonUtils::now() + node->m_period;
+				break;
+			}
+
+			if (numMissed)
+				node->m_numMissedTicks.store(node->m_numMissedTicks.load(std::memory_order_relaxed) + numMissed);
+			time_point t = node->m_nominal;
+			if (node->m_jitter.count() > 0)
+				t += duration(static_cast<duration::rep>(nextRandom() % static_cast<uint64_t>(node->m_jitter.count())));
+			node->m_time = applySlack(t, node->m_slack);
+		}
+
+		uint64_t nextRandom()
+		{
+			//xorshift64
+			m_randomState ^= m_randomState << 13;
+			m_randomState ^= m_randomState >> 7;
+			m_randomState ^= m_randomState << 17;
+			return m_randomState;
+		}
+
 	public:
 
-		Scheduler(std::function<void(T)> predicate)
-			:m_processor(predicate)
+		Scheduler(std::function<void(T&&)> predicate,
+			const ThreadOptions& threadOptions = ThreadOptions(),
+			const SchedulerOptions& schedulerOptions = SchedulerOptions())
+			:Scheduler(std::move(predicate), nullptr, threadOptions, schedulerOptions)
 		{
+		}
+
+		//'periodicPredicate' processes the items pushed with emplace_periodic()
+		Scheduler(std::function<void(T&&)> predicate,
+			std::function<void(T&)> periodicPredicate,
+			const ThreadOptions& threadOptions = ThreadOptions(),
+			const SchedulerOptions& schedulerOptions = SchedulerOptions())
+			:m_externalLoop(schedulerOptions.externalLoop),
+			m_processingQueue(schedulerOptions),
+			m_slack(schedulerOptions.slack),
+			m_processor(std::move(predicate)),
+			m_periodicProcessor(std::move(periodicPredicate))
+		{
+			if (m_externalLoop && SchedulerWakeup::TimerFd != schedulerOptions.wakeup)
+				throw std::invalid_argument("A scheduler run by an external loop needs SchedulerWakeup::TimerFd");
+
+			if (SchedulerWakeup::TimerFd == schedulerOptions.wakeup)
+				m_timerFd = std::make_unique<TimerFd>();
+
+			m_numCancelledResident = 0;
+			m_numWakeups = 0;
+			m_numFiringWakeups = 0;
+			m_numFired = 0;
+			m_maxFiredPerWakeup = 0;
+			m_randomState = (reinterpret_cast<uintptr_t>(this) ^ static_cast<uint64_t>(ULCommonUtils::now().time_since_epoch().count())) | 1;
 			m_terminate = false;
-			m_thread = stdThread(&Scheduler::run, this);
+			if (!m_externalLoop)
+				m_thread = Thread(threadOptions, [this]() { run(); });
+		}
+
+		//With SchedulerOptions::slack
+		TimerHandle push(const time_point& t, const T& item)
+		{
+			return emplace_slack(t, m_slack, item);
 		}
 
-		void push(const time_point& t, const T& item)
+		TimerHandle push(const time_point& t, T&& item)
 		{
+			return emplace_slack(t, m_slack, std::move(item));
+		}
+
+		//The item may fire anywhere in [t, t + slack], see applySlack()
+		TimerHandle push(const time_point& t, const duration& slack, const T& item)
+		{
+			return emplace_slack(t, slack, item);
+		}
+
+		TimerHandle push(const time_point& t, const duration& slack, T&& item)
+		{
+			return emplace_slack(t, slack, std::move(item));
+		}
+
+		template <class... Args>
+		TimerHandle emplace(const time_point& t, Args&&... args)
+		{
+			return emplace_slack(t, m_slack, std::forward<Args>(args)...);
+		}
+
+		template <class... Args>
+		TimerHandle emplace_slack(const time_point& t, const duration& slack, Args&&... args)
+		{
+			PeriodicOptions options;
+			options.slack = slack;
+			return emplaceNode(t, duration::zero(), options, std::forward<Args>(args)...);
+		}
+
+		//The item stays in the scheduler and is processed at 'first', 'first' + 'period', ... till it is cancelled, each
+		//run rescheduled by the scheduler thread without moving, copying or allocating anything(but the map's entry with
+		//TimerBackend::OrderedMap). PeriodicOptions::overrun decides what happens to the ticks a late or long run misses
+		//Throws std::invalid_argument for a period that isn't positive and std::logic_error without a periodic predicate
+		template <class... Args>
+		TimerHandle emplace_periodic(const time_point& first, const duration& period, const PeriodicOptions& options, Args&&... args)
+		{
+			if (period <= duration::zero())
+				throw std::invalid_argument("The period of a periodic item has to be positive");
+
+			if (!m_periodicProcessor)
+				throw std::logic_error("The scheduler has no predicate for periodic items");
+
+			return emplaceNode(first, period, options, std::forward<Args>(args)...);
+		}
+
+	private:
+		//'period' is 0 for an item processed once, which only looks at PeriodicOptions::slack
+		template <class... Args>
+		TimerHandle emplaceNode(const time_point& t, const duration& period, const PeriodicOptions& options, Args&&... args)
+		{
+			time_point fireAt = applySlack(t, options.slack);
+			TimerHandle handle;
+			{
+				stdUniqueLock lock(m_mutex);
+				Node* node = m_pool.allocate();
+				try
+				{
+					node->m_item.emplace(std::forward<Args>(args)...);
+					m_incoming.push_back(node);
+				}
+				catch (...)
+				{
+					node->m_item.reset();
+					m_pool.release(node);
+					throw;
+				}
+
+				node->m_time = fireAt;
+				node->m_nominal = t;
+				node->m_period = period;
+				node->m_slack = options.slack;
+				node->m_overrun = options.overrun;
+				node->m_jitter = options.jitter;
+				node->m_numMissedTicks = 0;
+				node->m_periodic.store(period.count() != 0, std::memory_order_relaxed);
+				uint64_t generation = node->generation();
+				node->m_stamp = TimerEntry::stamp(generation, TimerEntry::Pending);
+				handle = TimerHandle(this, node, generation);
+			}
+
+			wake();
+			return handle;
+		}
+
+	public:
+		//See TimerHandle::cancel()
+		bool cancel(TimerEntry* entry, uint64_t generation) override
+		{
+			if (!entry->tryCancel(generation))
+				return false;
+
+			m_numCancelledResident++;
+			bool firstInBatch = false;
 			{
 				stdUniqueLock lock(m_mutex);
-				m_itemQueue.push_back(TimeItemPair(t, item));
+				firstInBatch = m_cancelled.empty();
+				m_cancelled.push_back(static_cast<Node*>(entry));
 			}
 
-			m_cond.notify_one();
+			if (firstInBatch)
+				wake();
+			return true;
+		}
+
+		//SchedulerOptions::slack
+		const duration& slack() const
+		{
+			return m_slack;
+		}
+
+		//Cancelled items whose node is yet to be given back, stays up till their time with TimerBackend::OrderedMap
+		size_t numCancelledResident() const
+		{
+			return m_numCancelledResident.load();
+		}
+
+		SchedulerStats stats() const
+		{
+			SchedulerStats stats;
+			stats.numWakeups = m_numWakeups.load(std::memory_order_relaxed);
+			stats.numFiringWakeups = m_numFiringWakeups.load(std::memory_order_relaxed);
+			stats.numFired = m_numFired.load(std::memory_order_relaxed);
+			stats.maxFiredPerWakeup = m_maxFiredPerWakeup.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		//SchedulerWakeup::TimerFd, readable whenever poll() has something to do, -1 otherwise
+		int fd() const
+		{
+			return m_timerFd ? m_timerFd->fd() : -1;
+		}
+
+		//SchedulerOptions::externalLoop only, runs the items that are due and rearms fd() for the next one
+		//To be called by one thread at a time, once fd() is readable, or at any time as it doesn't block
+		void poll()
+		{
+			if (!m_externalLoop)
+				throw std::logic_error("Only a scheduler run by an external loop can be polled");
+
+			pollTimerFd();
+		}
+
+	private:
+		void processPending()
+		{
+			{
+				stdUniqueLock lock(m_mutex);
+				m_incoming.swap(m_swapIncoming);
+				m_cancelled.swap(m_swapCancelled);
+				for (Node* node : m_freed)
+					m_pool.release(node);
+			}
+			m_freed.clear();
+
+			//A cancelled node has been pushed before its cancellation, so it is in the queue by the time the latter is processed
+			for (Node* node : m_swapIncoming)
+				m_processingQueue.insert(node);
+			m_swapIncoming.clear();
+
+			for (Node* node : m_swapCancelled)
+				onCancelled(node);
+			m_swapCancelled.clear();
+
+			uint64_t numFired = m_numFired.load(std::memory_order_relaxed);
+			m_processingQueue.expire(ULCommonUtils::now(), [this](Node* node) { onDue(node); });
+			m_numWakeups.store(m_numWakeups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			uint64_t numFiredNow = m_numFired.load(std::memory_order_relaxed) - numFired;
+			if (numFiredNow)
+				m_numFiringWakeups.store(m_numFiringWakeups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			if (numFiredNow > m_maxFiredPerWakeup.load(std::memory_order_relaxed))
+				m_maxFiredPerWakeup.store(numFiredNow, std::memory_order_relaxed);
+		}
+
+		void pollTimerFd()
+		{
+			//Pushes and cancellations from here on make the fd readable again
+			m_timerFd->clear();
+			processPending();
+
+			time_point next;
+			if (m_processingQueue.nextExpiry(next))
+				m_timerFd->arm(next);
+			else
+				m_timerFd->disarm();
 		}
 
 		void run()
 		{
 			while (!m_terminate)
 			{
+				if (m_timerFd)
 				{
-					ConsumerQueue local;
-
-					{
-						stdUniqueLock lock(m_mutex);
-						m_itemQueue.swap(local);
-					}
-
-					for (auto currentItem : local)
-						m_processingQueue[currentItem.first].push_back(currentItem.second);
+					pollTimerFd();
+					if (!m_terminate)
+						m_timerFd->wait();
+					continue;
 				}
 
-				auto it = m_processingQueue.begin();
-				if (!m_processingQueue.empty())
-				{
-					if (it->first <= ULCommonUtils::now())
-					{
-						auto& processingQueue = it->second;
-						for (auto& item : processingQueue)
-							m_processor(item);
+				processPending();
 
-						m_processingQueue.erase(it);
-					}
-					else
-						m_cond.wait_until(it->first);
+				//Items pushed or cancelled meanwhile have signalled m_cond, so the wait returns right away for them
+				time_point next;
+				if (m_processingQueue.nextExpiry(next))
+				{
+					if (next > ULCommonUtils::now())
+						m_cond.wait_until(next);
 				}
 				else
 					m_cond.wait();
 			}
 		}
 
+	public:
 		~Scheduler()
 		{
 			kill();
@@ -227,13 +908,15 @@ namespace mtInternalUtils
 	private:
 		ConsumerQueue_SPtr m_queue;
 		stdMutex m_mutex;
-		ConditionVariable m_cond;
+		Event m_cond;
 		std::atomic<bool> m_terminate;
 		bool m_consumerBusy;//Used to avoid unnecessary signalling of consumer if it is busy processing the queue, purely performance
-		stdThread m_thread;
-		std::function<void(T)> m_processor;
-		duration m_unitTime;
-		ULCommonUtils::RingBuffer<time_point> m_transactionLog;
+		std::atomic<bool> m_hasItems;//Lets a spinning consumer look at the queue without taking the lock
+		Thread m_thread;
+		std::function<void(T&&)> m_processor;
+		RateLimiter m_limiter;
+		WaitStrategy m_waitStrategy;
+		duration m_spinDuration;
 
 		void run()
 		{
@@ -241,28 +924,32 @@ namespace mtInternalUtils
 			{
 				ConsumerQueue local;
 
+				spinUntil(m_waitStrategy, m_spinDuration, [this]() { return m_hasItems || m_terminate; });
+
 				{
 					stdUniqueLock lock(m_mutex);
 
-					if (m_queue->empty())
+					//A busy polling consumer never declares itself idle, so the producers never have to signal it
+					if (m_queue->empty() && WaitStrategy::BusyPoll != m_waitStrategy)
 					{
 						m_consumerBusy = false;
 						m_cond.wait(lock);
 					}
 
 					m_queue->swap(local);
+					m_hasItems = false;
 					m_consumerBusy = true;
 				}
 
-				for (auto const& currentItem : local)
+				for (auto& currentItem : local)
 				{
-					if (m_transactionLog.full() &&
-						((ULCommonUtils::now() - m_transactionLog.front()) <= m_unitTime)
-						)
-						std::this_thread::sleep_until(m_transactionLog.front() + m_unitTime);
+					auto now = ULCommonUtils::now();
+					auto availableAt = m_limiter.availableAt(now);
+					if (availableAt > now)
+						waitUntil(m_waitStrategy, m_spinDuration, availableAt);
 
-					m_transactionLog.push(ULCommonUtils::now());
-					m_processor(currentItem);
+					m_limiter.record(ULCommonUtils::now());
+					m_processor(std::move(currentItem));
 				}
 			}
 		}
@@ -270,22 +957,60 @@ namespace mtInternalUtils
 
 	public:
 
-		ThrottledConsumerThread(ConsumerQueue_SPtr queue, std::function<void(T)> predicate, duration unitTime, size_t numTransactions)
+		ThrottledConsumerThread(ConsumerQueue_SPtr queue,
+			std::function<void(T&&)> predicate,
+			const std::vector<RateLimit>& limits,
+			WaitStrategy waitStrategy = WaitStrategy::Blocking,
+			duration spinDuration = std::chrono::microseconds(50),
+			const ThreadOptions& threadOptions = ThreadOptions())
 			:m_queue(queue),
-			m_processor(predicate),
-			m_unitTime(unitTime),
-			m_transactionLog(numTransactions)
+			m_processor(std::move(predicate)),
+			m_limiter(limits),
+			m_waitStrategy(waitStrategy),
+			m_spinDuration(spinDuration)
 		{
 			m_terminate = false;
 			m_consumerBusy = false;
-			m_thread = stdThread(&ThrottledConsumerThread::run, this);
+			m_hasItems = false;
+			m_thread = Thread(threadOptions, [this]() { run(); });
 		}
 
 		void push(const T& item)
 		{
+			emplace(item);
+		}
+
+		void push(T&& item)
+		{
+			emplace(std::move(item));
+		}
+
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			{
+				stdUniqueLock lock(m_mutex);
+				m_queue->emplace_back(std::forward<Args>(args)...);
+				m_hasItems = true;
+
+				if (!m_consumerBusy)
+				{
+					lock.unlock();
+					m_cond.notify_one();
+				}
+			}
+		}
+
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			if (first == last)
+				return;
+
 			{
 				stdUniqueLock lock(m_mutex);
-				m_queue->push_back(item);
+				m_queue->insert(m_queue->end(), std::make_move_iterator(first), std::make_move_iterator(last));
+				m_hasItems = true;
 
 				if (!m_consumerBusy)
 				{
@@ -320,23 +1045,22 @@ namespace mtInternalUtils
 	private:
 		std::shared_ptr<ULMTTools::WorkerThread> m_worker;
 		std::shared_ptr<ULMTTools::TaskScheduler> m_scheduler;
+		std::vector<T> m_incomingQueue;//Items pushed by the clients, handed over to the worker in batches
+		stdMutex m_incomingMutex;
 		std::queue<T> m_pendingQueue;
-		std::function<void(T)> m_processor;
-		duration m_unitTime;
-		size_t m_numTransactions;
-		ULCommonUtils::RingBuffer<time_point> m_transactionLog;
+		std::function<void(T&&)> m_processor;
+		RateLimiter m_limiter;
 
-		void processItemAndUpdateTransactionLog(T item)
+		void processItemAndUpdateTransactionLog(T&& item)
 		{
-			m_processor(item);
-			m_transactionLog.push(ULCommonUtils::now());
+			m_processor(std::move(item));
+			m_limiter.record(ULCommonUtils::now());
 		}
 
 		bool bandWidthAvailable()
 		{
-			return	!((m_transactionLog.full()) &&
-					  ((ULCommonUtils::now() - m_transactionLog.front()) < m_unitTime)
-					 );
+			auto now = ULCommonUtils::now();
+			return m_limiter.availableAt(now) <= now;
 		}
 
 		void scheduleBandwidthAvailableEvent(time_point scheduleTime)
@@ -350,19 +1074,31 @@ namespace mtInternalUtils
 			});
 		}
 
-		void tryProcess(T item)
+		void processIncoming()
+		{
+			std::vector<T> local;
+			{
+				stdUniqueLock lock(m_incomingMutex);
+				local.swap(m_incomingQueue);
+			}
+
+			for (auto& item : local)
+				tryProcess(std::move(item));
+		}
+
+		void tryProcess(T&& item)
 		{
 			//there are still some pending items so, queue it up behind them, even if the bandwidth is available
 			//so as not to spoil the fifo order
 			if (!m_pendingQueue.empty())
-				m_pendingQueue.push(item);
+				m_pendingQueue.push(std::move(item));
 			else if (!bandWidthAvailable())//no pending items but bandwidth is unavailable, scehdule the processing event for next available timeslot
 			{
-				m_pendingQueue.push(item);
-				scheduleBandwidthAvailableEvent(m_transactionLog.front() + m_unitTime);
+				m_pendingQueue.push(std::move(item));
+				scheduleBandwidthAvailableEvent(m_limiter.availableAt(ULCommonUtils::now()));
 			}
 			else//No pending items and bandwidth is available, so process it right away
-				processItemAndUpdateTransactionLog(item);
+				processItemAndUpdateTransactionLog(std::move(item));
 		}
 
 		//"allotedTime" parameter will be useful for debugging purposes to see
@@ -371,36 +1107,55 @@ namespace mtInternalUtils
 		{
 			while (bandWidthAvailable() && !m_pendingQueue.empty())
 			{
-				processItemAndUpdateTransactionLog(m_pendingQueue.front());
+				processItemAndUpdateTransactionLog(std::move(m_pendingQueue.front()));
 				m_pendingQueue.pop();
 			}
 
 			//pending queue was not processed because of insufficient bandwidth,
 			//reschedule the bandwidth available event for the next slot of bandwidth availability
 			if (!m_pendingQueue.empty())
-				scheduleBandwidthAvailableEvent(m_transactionLog.front() + m_unitTime);
+				scheduleBandwidthAvailableEvent(m_limiter.availableAt(ULCommonUtils::now()));
 		}
 
 	public:
 
 		ReusableThrottler(std::shared_ptr<ULMTTools::WorkerThread> worker,
 			std::shared_ptr<ULMTTools::TaskScheduler> scheduler,
-			std::function<void(T)> predicate,
-			duration unitTime,
-			size_t numTransactions
+			std::function<void(T&&)> predicate,
+			const std::vector<RateLimit>& limits
 		)
 			:m_worker(worker),
 			m_scheduler(scheduler),
-			m_processor(predicate),
-			m_unitTime(unitTime),
-			m_numTransactions(numTransactions),
-			m_transactionLog(numTransactions)
+			m_processor(std::move(predicate)),
+			m_limiter(limits)
 		{
 		}
 
 		void push(const T& item)
 		{
-			m_worker->push([this, item]() {tryProcess(item); });
+			emplace(item);
+		}
+
+		void push(T&& item)
+		{
+			emplace(std::move(item));
+		}
+
+		//The item is constructed in the incoming queue rather than captured in a closure for the worker,
+		//so it is only ever moved till it is processed and no closure has to be allocated per item
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			bool firstInBatch = false;
+			{
+				stdUniqueLock lock(m_incomingMutex);
+				firstInBatch = m_incomingQueue.empty();
+				m_incomingQueue.emplace_back(std::forward<Args>(args)...);
+			}
+
+			//Only the item starting a new batch needs to get the batch processed, the later ones ride along with it
+			if (firstInBatch)
+				m_worker->push([this]() {processIncoming(); });
 		}
 
 		void kill()
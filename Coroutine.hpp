@@ -0,0 +1,394 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "Future.hpp"
+
+namespace mtInternalUtils
+{
+	//Allocator for coroutine frames, frames are binned into size classes and recycled through per thread caches
+	//backed by a global pool, the same way as the shared states of the futures
+	//Frames bigger than the largest size class go to the heap as usual
+	class FramePool
+	{
+		static constexpr size_t granularity = 64;
+		static constexpr size_t numSizeClasses = 16;//i.e. frames of upto 1KB are pooled
+		static constexpr size_t batchSize = 32;
+
+		typedef std::vector<void*> FreeList;
+
+		struct GlobalPool
+		{
+			stdMutex m_mutex;
+			FreeList m_freeLists[numSizeClasses];
+
+			~GlobalPool()
+			{
+				for (auto& freeList : m_freeLists)
+					for (void* frame : freeList)
+						::operator delete(frame);
+			}
+		};
+
+		struct LocalCache
+		{
+			FreeList m_freeLists[numSizeClasses];
+
+			~LocalCache()
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				for (size_t i = 0; i < numSizeClasses; i++)
+					pool.m_freeLists[i].insert(pool.m_freeLists[i].end(), m_freeLists[i].begin(), m_freeLists[i].end());
+			}
+		};
+
+		static GlobalPool& globalPool()
+		{
+			static GlobalPool pool;
+			return pool;
+		}
+
+		static LocalCache& localCache()
+		{
+			thread_local LocalCache cache;
+			return cache;
+		}
+
+		static size_t sizeClass(size_t size)
+		{
+			return (size + granularity - 1) / granularity - 1;
+		}
+
+		static void moveBatch(FreeList& from, FreeList& to)
+		{
+			size_t numToMove = std::min(from.size(), batchSize);
+			to.insert(to.end(), from.end() - numToMove, from.end());
+			from.resize(from.size() - numToMove);
+		}
+
+	public:
+		static void* allocate(size_t size)
+		{
+			size_t cls = sizeClass(size);
+			if (cls >= numSizeClasses)
+				return ::operator new(size);
+
+			FreeList& freeList = localCache().m_freeLists[cls];
+			if (freeList.empty())
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				moveBatch(pool.m_freeLists[cls], freeList);
+			}
+
+			if (freeList.empty())
+				return ::operator new((cls + 1) * granularity);
+
+			void* frame = freeList.back();
+			freeList.pop_back();
+			return frame;
+		}
+
+		static void deallocate(void* frame, size_t size)
+		{
+			size_t cls = sizeClass(size);
+			if (cls >= numSizeClasses)
+			{
+				::operator delete(frame);
+				return;
+			}
+
+			//Frames are often freed on a different thread than the one they were allocated on, after a hop to a worker,
+			//so a cache growing past 2 batches hands one over to the global pool
+			FreeList& freeList = localCache().m_freeLists[cls];
+			freeList.push_back(frame);
+			if (freeList.size() >= 2 * batchSize)
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				moveBatch(freeList, pool.m_freeLists[cls]);
+			}
+		}
+	};
+
+	//Base of the promise types, makes the compiler allocate the frames from the FramePool
+	struct PooledFrame
+	{
+		static void* operator new(size_t size)
+		{
+			return FramePool::allocate(size);
+		}
+
+		static void operator delete(void* frame, size_t size)
+		{
+			FramePool::deallocate(frame, size);
+		}
+	};
+
+	//Awaitable resuming the coroutine on 'executor'(anything with a push(Task&&)), the Task only holds the coroutine handle
+	//so it stays within the Task's inline buffer
+	template <class Executor>
+	class ScheduleAwaitable
+	{
+		Executor& m_executor;
+
+	public:
+		explicit ScheduleAwaitable(Executor& executor) : m_executor(executor)
+		{
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		//If the push throws(e.g. the executor has been killed), the coroutine is resumed right away with that exception
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			m_executor.push([handle]() { handle.resume(); });
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	//Awaitable resuming the coroutine on the thread of 'scheduler'(anything with a push(time_point, Task&&)) at 'time'
+	template <class Scheduler>
+	class SleepAwaitable
+	{
+		Scheduler& m_scheduler;
+		time_point m_time;
+
+	public:
+		SleepAwaitable(Scheduler& scheduler, const time_point& time) : m_scheduler(scheduler), m_time(time)
+		{
+		}
+
+		bool await_ready() const
+		{
+			return m_time <= ULCommonUtils::now();
+		}
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			m_scheduler.push(m_time, [handle]() { handle.resume(); });
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	template <class T>
+	struct CoTaskPromiseResult
+	{
+		std::optional<T> m_value;
+
+		template <class U>
+		void return_value(U&& value)
+		{
+			m_value.emplace(std::forward<U>(value));
+		}
+
+		T takeResult()
+		{
+			return std::move(*m_value);
+		}
+	};
+
+	template <>
+	struct CoTaskPromiseResult<void>
+	{
+		void return_void()
+		{
+		}
+
+		void takeResult()
+		{
+		}
+	};
+}
+
+namespace ULMTTools
+{
+	//Lazily started coroutine producing a T, runs when awaited(or passed to spawn()) and resumes its awaiter when done
+	//The frames come from mtInternalUtils::FramePool
+	template <class T = void>
+	class CoTask
+	{
+	public:
+		struct promise_type : mtInternalUtils::PooledFrame, mtInternalUtils::CoTaskPromiseResult<T>
+		{
+			std::coroutine_handle<> m_continuation;
+			std::exception_ptr m_exception;
+
+			struct FinalAwaitable
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				//Symmetric transfer, resuming the awaiter doesn't grow the stack however long the chain of awaits is
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().m_continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept
+				{
+				}
+			};
+
+			CoTask get_return_object()
+			{
+				return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() const noexcept
+			{
+				return {};
+			}
+
+			FinalAwaitable final_suspend() const noexcept
+			{
+				return {};
+			}
+
+			void unhandled_exception()
+			{
+				m_exception = std::current_exception();
+			}
+		};
+
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+
+		explicit CoTask(std::coroutine_handle<promise_type> handle) : m_handle(handle)
+		{
+		}
+
+	public:
+		CoTask(CoTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr))
+		{
+		}
+
+		CoTask& operator=(CoTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (m_handle)
+					m_handle.destroy();
+				m_handle = std::exchange(other.m_handle, nullptr);
+			}
+
+			return *this;
+		}
+
+		CoTask(const CoTask&) = delete;
+		CoTask& operator=(const CoTask&) = delete;
+
+		bool await_ready() const noexcept
+		{
+			return !m_handle || m_handle.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			m_handle.promise().m_continuation = awaiter;
+			return m_handle;
+		}
+
+		T await_resume()
+		{
+			if (m_handle.promise().m_exception)
+				std::rethrow_exception(m_handle.promise().m_exception);
+
+			return m_handle.promise().takeResult();
+		}
+
+		~CoTask()
+		{
+			if (m_handle)
+				m_handle.destroy();
+		}
+	};
+}
+
+namespace mtInternalUtils
+{
+	//Fire and forget coroutine driving a CoTask for spawn(), destroys itself when done
+	struct DetachedCoroutine
+	{
+		struct promise_type : PooledFrame
+		{
+			DetachedCoroutine get_return_object() const noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never initial_suspend() const noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() const noexcept
+			{
+				return {};
+			}
+
+			void return_void() const noexcept
+			{
+			}
+
+			//drive() catches everything itself
+			void unhandled_exception() const noexcept
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	template <class T>
+	DetachedCoroutine drive(ULMTTools::CoTask<T> task, ULMTTools::Promise<T> promise)
+	{
+		std::exception_ptr exception;
+		try
+		{
+			if constexpr (std::is_void_v<T>)
+			{
+				co_await task;
+				promise.set_value();
+			}
+			else
+				promise.set_value(co_await task);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		if (exception)
+			promise.set_exception(exception);
+	}
+}
+
+namespace ULMTTools
+{
+	//Starts 'task' on the calling thread, it runs till its first suspension before spawn() returns
+	//The returned future gets its result, or the exception it ends with
+	template <class T>
+	Future<T> spawn(CoTask<T> task)
+	{
+		Promise<T> promise;
+		Future<T> future = promise.get_future();
+		mtInternalUtils::drive(std::move(task), std::move(promise));
+		return future;
+	}
+}
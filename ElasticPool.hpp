@@ -0,0 +1,303 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Event.hpp"
+#include "Task.hpp"
+#include "Thread.hpp"
+
+namespace mtInternalUtils
+{
+	//Sizing of an ElasticPool
+	struct ElasticPoolOptions
+	{
+		size_t minThreads = 1;//Started right away and never retired
+		size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		//A worker is added when a push finds no idle worker and more than this many tasks waiting to be picked up
+		size_t queueDepthThreshold = 0;
+		//A worker is added when a task has waited longer than this to be picked up, 0 disables the check
+		//Checked on every push and every time a worker picks up a task
+		duration waitTimeThreshold = duration::zero();
+		//A worker above minThreads finding nothing to do for this long exits
+		duration idleTimeout = std::chrono::seconds(10);
+	};
+
+	//Pool of threads sharing one queue whose no. of threads follows the load between ElasticPoolOptions::minThreads and maxThreads
+	//Workers are added as the queue backs up and retire after sitting idle for ElasticPoolOptions::idleTimeout
+	//Each idle worker parks on its own Event, and a push wakes one parked worker before it considers adding one
+	class ElasticPool
+	{
+		struct Worker
+		{
+			Event m_event;
+			bool m_idle;//Guarded by m_mutex
+			Thread m_thread;
+
+			Worker() : m_idle(false)
+			{
+			}
+		};
+
+		struct QueuedTask
+		{
+			Task m_task;
+			time_point m_queuedAt;
+		};
+
+		const ElasticPoolOptions m_options;
+		const ThreadOptions m_threadOptions;
+
+		stdMutex m_mutex;
+		std::deque<QueuedTask> m_tasks;
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::vector<Worker*> m_idleWorkers;
+		//Workers that have exited on their own and are yet to be joined, joined by the next worker retiring or by kill()
+		std::vector<std::unique_ptr<Worker>> m_retired;
+		size_t m_numSpawned;//For naming and pinning the workers, a retired worker's index isn't reused
+		//Copies of m_workers.size() and its highest value so far, written with m_mutex held, readable without it
+		std::atomic<size_t> m_numThreads;
+		std::atomic<size_t> m_peakThreads;
+		bool m_terminate;
+
+		//No. of workers is changed only with m_mutex held, so the decision to add one is never taken twice for the same backlog
+		//Returns false if the OS refused to start the thread
+		bool spawnLocked()
+		{
+			auto worker = std::make_unique<Worker>();
+			Worker* ptr = worker.get();
+			try
+			{
+				worker->m_thread = Thread(workerThreadOptions(m_threadOptions, m_numSpawned), [this, ptr]() { run(ptr); });
+			}
+			catch (const std::system_error&)
+			{
+				if (m_workers.empty())
+					throw;
+
+				//The workers already there will get to the tasks, just later
+				return false;
+			}
+
+			m_numSpawned++;
+			m_workers.push_back(std::move(worker));
+			m_numThreads = m_workers.size();
+			m_peakThreads = std::max(m_peakThreads.load(), m_workers.size());
+			return true;
+		}
+
+		bool waitedTooLong(const QueuedTask& queued, const time_point& now) const
+		{
+			return m_options.waitTimeThreshold.count() && now - queued.m_queuedAt > m_options.waitTimeThreshold;
+		}
+
+		//After tasks are queued, hand them to an idle worker or add one if the backlog calls for it
+		void dispatchLocked()
+		{
+			if (!m_idleWorkers.empty())
+			{
+				Worker* worker = m_idleWorkers.back();
+				m_idleWorkers.pop_back();
+				worker->m_idle = false;
+				worker->m_event.notify();
+				return;
+			}
+
+			if (m_workers.size() >= m_options.maxThreads)
+				return;
+
+			if (m_workers.empty() ||
+				m_tasks.size() > m_options.queueDepthThreshold ||
+				waitedTooLong(m_tasks.front(), ULCommonUtils::now()))
+				spawnLocked();
+		}
+
+		//'numTasks' being the no. of tasks just queued, which are taken back if there is no worker to run them
+		void enqueue(size_t numTasks)
+		{
+			try
+			{
+				dispatchLocked();
+			}
+			catch (...)
+			{
+				//Not a single worker could be started, so the tasks are refused
+				m_tasks.erase(m_tasks.end() - numTasks, m_tasks.end());
+				throw;
+			}
+		}
+
+		void checkAlive() const
+		{
+			if (m_terminate)
+				throw std::runtime_error("The thread pool has been killed and is no longer in a state to process new tasks");
+		}
+
+		void retireLocked(Worker* self, stdUniqueLock& lock)
+		{
+			auto it = std::find_if(m_workers.begin(), m_workers.end(), [self](auto& worker) { return worker.get() == self; });
+			std::vector<std::unique_ptr<Worker>> toJoin;
+			toJoin.swap(m_retired);
+			m_retired.push_back(std::move(*it));
+			m_workers.erase(it);
+			m_numThreads = m_workers.size();
+
+			lock.unlock();
+			for (auto& worker : toJoin)
+				worker->m_thread.join();
+		}
+
+		void run(Worker* self)
+		{
+			stdUniqueLock lock(m_mutex);
+			while (true)
+			{
+				if (!m_tasks.empty())
+				{
+					QueuedTask queued = std::move(m_tasks.front());
+					m_tasks.pop_front();
+					//A task that waited too long means the workers aren't keeping up with what is still queued
+					if (!m_terminate && !m_tasks.empty() && m_idleWorkers.empty() && m_workers.size() < m_options.maxThreads &&
+						waitedTooLong(queued, ULCommonUtils::now()))
+						spawnLocked();
+
+					lock.unlock();
+					queued.m_task();
+					lock.lock();
+					continue;
+				}
+
+				//Pending tasks are processed even after a kill, same as WorkerThread
+				if (m_terminate)
+					break;
+
+				self->m_idle = true;
+				m_idleWorkers.push_back(self);
+				time_point deadline = ULCommonUtils::now() + m_options.idleTimeout;
+				self->m_event.wait_until(deadline, lock);
+				if (!self->m_idle)
+					continue;
+
+				//Not woken by a push, so either timed out or woken by kill()
+				self->m_idle = false;
+				m_idleWorkers.erase(std::find(m_idleWorkers.begin(), m_idleWorkers.end(), self));
+				if (!m_terminate && m_tasks.empty() && m_workers.size() > m_options.minThreads && ULCommonUtils::now() >= deadline)
+				{
+					retireLocked(self, lock);
+					return;
+				}
+			}
+		}
+
+	public:
+		//Throws std::invalid_argument for an empty or inverted range of threads, and std::system_error if the first
+		//ElasticPoolOptions::minThreads workers can't be started as 'threadOptions' asks
+		//Worker i gets workerThreadOptions(threadOptions, i), i counting every worker ever started
+		ElasticPool(const ElasticPoolOptions& options, const ThreadOptions& threadOptions) :
+			m_options(options),
+			m_threadOptions(threadOptions),
+			m_numSpawned(0),
+			m_numThreads(0),
+			m_peakThreads(0),
+			m_terminate(false)
+		{
+			if (!m_options.maxThreads || m_options.minThreads > m_options.maxThreads)
+				throw std::invalid_argument("An elastic thread pool needs 1 <= maxThreads and minThreads <= maxThreads");
+
+			try
+			{
+				stdUniqueLock lock(m_mutex);
+				for (size_t i = 0; i < m_options.minThreads; i++)
+					if (!spawnLocked())
+						throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "Couldn't start the minimum no. of threads");
+			}
+			catch (...)
+			{
+				kill();
+				throw;
+			}
+		}
+
+		ElasticPool(const ElasticPool&) = delete;
+		ElasticPool& operator=(const ElasticPool&) = delete;
+
+		void push(Task&& task)
+		{
+			stdUniqueLock lock(m_mutex);
+			checkAlive();
+			m_tasks.push_back(QueuedTask{ std::move(task), ULCommonUtils::now() });
+			enqueue(1);
+		}
+
+		template <class F>
+		void emplace(F&& func)
+		{
+			stdUniqueLock lock(m_mutex);
+			checkAlive();
+			m_tasks.push_back(QueuedTask{ Task(std::forward<F>(func)), ULCommonUtils::now() });
+			enqueue(1);
+		}
+
+		//The tasks in the range are moved from, takes the lock only once and may add more than one worker
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			stdUniqueLock lock(m_mutex);
+			checkAlive();
+			time_point now = ULCommonUtils::now();
+			size_t numTasks = 0;
+			for (; first != last; ++first, ++numTasks)
+				m_tasks.push_back(QueuedTask{ std::move(*first), now });
+
+			for (size_t i = 0; i < numTasks; i++)
+				enqueue(numTasks - i);
+		}
+
+		//No. of threads right now
+		size_t numThreads() const
+		{
+			return m_numThreads.load();
+		}
+
+		//Highest no. of threads there has been at the same time
+		size_t peakThreads() const
+		{
+			return m_peakThreads.load();
+		}
+
+		size_t maxThreads() const
+		{
+			return m_options.maxThreads;
+		}
+
+		//Returns after all the tasks pushed so far have been processed
+		void kill()
+		{
+			{
+				stdUniqueLock lock(m_mutex);
+				if (m_terminate)
+					return;
+
+				//No worker is added or retires from here on, so m_workers is left alone by everyone else
+				m_terminate = true;
+				for (Worker* worker : m_idleWorkers)
+					worker->m_event.notify();
+			}
+
+			for (auto& worker : m_workers)
+				worker->m_thread.join();
+
+			for (auto& worker : m_retired)
+				worker->m_thread.join();
+		}
+
+		~ElasticPool()
+		{
+			kill();
+		}
+	};
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include "ConditionVariable.hpp"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mtInternalUtils
+{
+#if defined(__linux__)
+	//Auto reset event with the same interface as ConditionVariable, i.e. a notify() is remembered till a wait consumes it
+	//and a wait consumes at most one notify(), but built directly on a futex instead of a mutex + condition variable
+	//Waking up a sleeping thread costs an atomic store plus one FUTEX_WAKE syscall, and notify() doesn't make any
+	//syscall at all if nobody is waiting, which is the common case for a busy consumer
+	class Event
+	{
+		std::atomic<uint32_t> m_signalled;//The futex word, 0 or 1
+		std::atomic<uint32_t> m_numWaiters;
+
+		static long futex(std::atomic<uint32_t>* word, int op, uint32_t val, const timespec* timeout)
+		{
+			return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, val, timeout, nullptr, FUTEX_BITSET_MATCH_ANY);
+		}
+
+		bool tryConsume()
+		{
+			return m_signalled.load(std::memory_order_relaxed) && m_signalled.exchange(0);
+		}
+
+		//'deadline' is absolute and measured against CLOCK_REALTIME if 'realtime' is set, CLOCK_MONOTONIC otherwise
+		//nullptr means wait indefinitely
+		void waitImpl(const timespec* deadline, bool realtime)
+		{
+			if (tryConsume())
+				return;
+
+			//Registering as a waiter before looking at m_signalled again pairs with notify() storing m_signalled
+			//before looking at m_numWaiters, so either we see the signal or the notifier sees us
+			m_numWaiters.fetch_add(1);
+			while (!tryConsume())
+			{
+				int op = FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG | (realtime ? FUTEX_CLOCK_REALTIME : 0);
+				if (-1 == futex(&m_signalled, op, 0, deadline) && ETIMEDOUT == errno)
+				{
+					tryConsume();
+					break;
+				}
+			}
+			m_numWaiters.fetch_sub(1);
+		}
+
+		template <class Rep, class Period>
+		static timespec toTimespec(const std::chrono::duration<Rep, Period>& sinceEpoch)
+		{
+			if (sinceEpoch.count() <= 0)
+				return timespec{ 0, 0 };
+
+			auto secs = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+			auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - secs);
+			return timespec{ static_cast<time_t>(secs.count()), static_cast<long>(nanos.count()) };
+		}
+
+	public:
+		Event()
+		{
+			m_signalled = 0;
+			m_numWaiters = 0;
+		}
+
+		Event(const Event&) = delete;
+		Event& operator=(const Event&) = delete;
+
+		//Whenever in Critical section and have the instance of unique lock, use the versions of wait() with 'lock'
+		//as waiting in a critical section without releasing the lock will be the last thing we want to do
+
+		void wait()
+		{
+			waitImpl(nullptr, false);
+		}
+
+		void wait(stdUniqueLock& applicationLock)
+		{
+			applicationLock.unlock();
+			wait();
+			applicationLock.lock();
+		}
+
+		template <class Clock, class Duration>
+		void wait_until(const std::chrono::time_point<Clock, Duration>& time)
+		{
+			//The futex understands only the 2 clocks below, any other clock is translated to the monotonic one
+			if constexpr (std::is_same_v<Clock, std::chrono::system_clock>)
+			{
+				timespec deadline = toTimespec(time.time_since_epoch());
+				waitImpl(&deadline, true);
+			}
+			else if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>)
+			{
+				timespec deadline = toTimespec(time.time_since_epoch());
+				waitImpl(&deadline, false);
+			}
+			else
+				wait_for(time - Clock::now());
+		}
+
+		template <class Clock, class Duration>
+		void wait_until(const std::chrono::time_point<Clock, Duration>& time, stdUniqueLock& applicationLock)
+		{
+			applicationLock.unlock();
+			wait_until(time);
+			applicationLock.lock();
+		}
+
+		template <class Rep, class Period>
+		void wait_for(const std::chrono::duration<Rep, Period>& duration)
+		{
+			wait_until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+		}
+
+		template <class Rep, class Period>
+		void wait_for(const std::chrono::duration<Rep, Period>& duration, stdUniqueLock& applicationLock)
+		{
+			applicationLock.unlock();
+			wait_for(duration);
+			applicationLock.lock();
+		}
+
+		void notify()
+		{
+			m_signalled.store(1);
+			if (m_numWaiters.load())
+				futex(&m_signalled, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, nullptr);
+		}
+
+		//For drop-in compatibility with ConditionVariable
+		void notify_one()
+		{
+			notify();
+		}
+	};
+#else
+	//No futex outside Linux, fall back to the mutex + condition variable based implementation
+	class Event : public ConditionVariable
+	{
+	public:
+		void notify()
+		{
+			notify_one();
+		}
+	};
+#endif
+	DEFINE_PTR(Event)
+}
@@ -0,0 +1,673 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Event.hpp"
+#include "Task.hpp"
+
+namespace mtInternalUtils
+{
+	//Stands in for the value of a Future<void>
+	struct Unit
+	{
+	};
+
+	template <class T>
+	using StoredType = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+	//State shared by a Promise and its Future, recycled through per thread caches backed by a global pool,
+	//so that a submit() round trip normally doesn't touch the heap for it
+	template <class T>
+	class SharedState
+	{
+		typedef StoredType<T> Stored;
+
+		//Per thread caches exchange states with the global pool in batches of this many, to keep its mutex off the common path
+		static constexpr size_t poolBatchSize = 32;
+
+		struct GlobalPool
+		{
+			stdMutex m_mutex;
+			std::vector<SharedState*> m_states;
+
+			~GlobalPool()
+			{
+				for (SharedState* state : m_states)
+					delete state;
+			}
+		};
+
+		struct LocalCache
+		{
+			std::vector<SharedState*> m_states;
+
+			~LocalCache()
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				pool.m_states.insert(pool.m_states.end(), m_states.begin(), m_states.end());
+			}
+		};
+
+		std::atomic<uint32_t> m_refCount;
+		std::atomic<bool> m_ready;
+		std::optional<Stored> m_value;
+		std::exception_ptr m_exception;
+		stdMutex m_mutex;//Orders adding a continuation against the completion
+		Task m_continuation;
+		std::vector<Task> m_moreContinuations;//Only used when a when_all/when_any and then() watch the same state
+		Event m_event;
+
+		SharedState()
+		{
+			m_refCount = 1;
+			m_ready = false;
+		}
+
+		static GlobalPool& globalPool()
+		{
+			static GlobalPool pool;
+			return pool;
+		}
+
+		static LocalCache& localCache()
+		{
+			thread_local LocalCache cache;
+			return cache;
+		}
+
+		//States are released on whichever thread drops the last reference, which for submit() is often the worker,
+		//so the caches even out through the global pool instead of the producer's cache running dry
+		void recycle()
+		{
+			m_value.reset();
+			m_exception = nullptr;
+			m_ready.store(false, std::memory_order_relaxed);
+
+			LocalCache& cache = localCache();
+			cache.m_states.push_back(this);
+			if (cache.m_states.size() >= 2 * poolBatchSize)
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				pool.m_states.insert(pool.m_states.end(), cache.m_states.end() - poolBatchSize, cache.m_states.end());
+				cache.m_states.resize(cache.m_states.size() - poolBatchSize);
+			}
+		}
+
+		template <class... Args>
+		void complete(std::exception_ptr exception, Args&&... args)
+		{
+			Task continuation;
+			std::vector<Task> moreContinuations;
+			{
+				stdUniqueLock lock(m_mutex);
+				if (m_ready.load(std::memory_order_relaxed))
+					throw std::future_error(std::future_errc::promise_already_satisfied);
+
+				if (exception)
+					m_exception = std::move(exception);
+				else
+					m_value.emplace(std::forward<Args>(args)...);
+
+				m_ready.store(true, std::memory_order_release);
+				continuation = std::move(m_continuation);
+				moreContinuations.swap(m_moreContinuations);
+			}
+
+			m_event.notify();
+			//Inline, on the completing thread
+			if (continuation)
+				continuation();
+			for (Task& task : moreContinuations)
+				task();
+		}
+
+	public:
+		SharedState(const SharedState&) = delete;
+		SharedState& operator=(const SharedState&) = delete;
+
+		//Returns a state with a single reference
+		static SharedState* acquire()
+		{
+			LocalCache& cache = localCache();
+			if (cache.m_states.empty())
+			{
+				GlobalPool& pool = globalPool();
+				stdUniqueLock lock(pool.m_mutex);
+				size_t numToTake = std::min(pool.m_states.size(), poolBatchSize);
+				cache.m_states.insert(cache.m_states.end(), pool.m_states.end() - numToTake, pool.m_states.end());
+				pool.m_states.resize(pool.m_states.size() - numToTake);
+			}
+
+			if (cache.m_states.empty())
+				return new SharedState();
+
+			SharedState* state = cache.m_states.back();
+			cache.m_states.pop_back();
+			state->m_refCount.store(1, std::memory_order_relaxed);
+			return state;
+		}
+
+		void addRef()
+		{
+			m_refCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void release()
+		{
+			if (1 == m_refCount.fetch_sub(1, std::memory_order_acq_rel))
+				recycle();
+		}
+
+		bool ready() const
+		{
+			return m_ready.load(std::memory_order_acquire);
+		}
+
+		template <class... Args>
+		void setValue(Args&&... args)
+		{
+			complete(nullptr, std::forward<Args>(args)...);
+		}
+
+		void setException(std::exception_ptr exception)
+		{
+			complete(std::move(exception));
+		}
+
+		void wait()
+		{
+			while (!ready())
+				m_event.wait();
+		}
+
+		template <class Clock, class Duration>
+		bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline)
+		{
+			while (!ready() && Clock::now() < deadline)
+				m_event.wait_until(deadline);
+
+			return ready();
+		}
+
+		//Only after ready() returned true, rethrows the exception the state was completed with
+		Stored& value()
+		{
+			if (m_exception)
+				std::rethrow_exception(m_exception);
+
+			return *m_value;
+		}
+
+		std::exception_ptr exception() const
+		{
+			return m_exception;
+		}
+
+		//Runs 'continuation' on the completing thread once the state is ready, or right away on this thread if it already is
+		void onReady(Task&& continuation)
+		{
+			{
+				stdUniqueLock lock(m_mutex);
+				if (!m_ready.load(std::memory_order_relaxed))
+				{
+					if (!m_continuation)
+						m_continuation = std::move(continuation);
+					else
+						m_moreContinuations.push_back(std::move(continuation));
+					return;
+				}
+			}
+
+			continuation();
+		}
+	};
+
+	//Owning reference to a SharedState, move only
+	template <class T>
+	class StateRef
+	{
+		SharedState<T>* m_state;
+
+	public:
+		StateRef() : m_state(nullptr)
+		{
+		}
+
+		explicit StateRef(SharedState<T>* state) : m_state(state)
+		{
+		}
+
+		StateRef(StateRef&& other) noexcept : m_state(other.m_state)
+		{
+			other.m_state = nullptr;
+		}
+
+		StateRef& operator=(StateRef&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				m_state = other.m_state;
+				other.m_state = nullptr;
+			}
+
+			return *this;
+		}
+
+		StateRef(const StateRef&) = delete;
+		StateRef& operator=(const StateRef&) = delete;
+
+		StateRef share() const
+		{
+			m_state->addRef();
+			return StateRef(m_state);
+		}
+
+		SharedState<T>* get() const
+		{
+			return m_state;
+		}
+
+		SharedState<T>* operator->() const
+		{
+			return m_state;
+		}
+
+		explicit operator bool() const
+		{
+			return nullptr != m_state;
+		}
+
+		void reset()
+		{
+			if (m_state)
+			{
+				m_state->release();
+				m_state = nullptr;
+			}
+		}
+
+		~StateRef()
+		{
+			reset();
+		}
+	};
+}
+
+namespace ULMTTools
+{
+	template <class T>
+	class Future;
+
+	template <class T>
+	class Promise;
+
+	template <class T>
+	struct WhenAnyResult
+	{
+		size_t index;//Of the future that became ready first, size_t(-1) if when_any() was given no futures
+		std::vector<Future<T>> futures;
+	};
+}
+
+namespace mtInternalUtils
+{
+	template <class T, class F>
+	struct ContinuationResult
+	{
+		typedef std::invoke_result_t<F, T&&> type;
+	};
+
+	template <class F>
+	struct ContinuationResult<void, F>
+	{
+		typedef std::invoke_result_t<F> type;
+	};
+
+	//Completes 'promise' with the outcome of invoking 'func' with 'args', or with the exception it throws
+	template <class R, class F, class... Args>
+	void fulfil(ULMTTools::Promise<R>& promise, F& func, Args&&... args)
+	{
+		try
+		{
+			if constexpr (std::is_void_v<R>)
+			{
+				func(std::forward<Args>(args)...);
+				promise.set_value();
+			}
+			else
+				promise.set_value(func(std::forward<Args>(args)...));
+		}
+		catch (...)
+		{
+			promise.set_exception(std::current_exception());
+		}
+	}
+
+	//Pushes 'func' to 'executor' and returns the future of its result, an exception thrown by 'func' ends up in the future
+	template <class Executor, class F>
+	auto submit(Executor& executor, F&& func) -> ULMTTools::Future<std::invoke_result_t<std::decay_t<F>&>>
+	{
+		typedef std::invoke_result_t<std::decay_t<F>&> R;
+		ULMTTools::Promise<R> promise;
+		ULMTTools::Future<R> future = promise.get_future();
+		executor.emplace([promise = std::move(promise), func = std::forward<F>(func)]() mutable
+			{
+				fulfil(promise, func);
+			});
+
+		return future;
+	}
+
+	//Runs 'func' on the value of the ready 'state', an exception in 'state' goes to 'promise' without calling 'func'
+	template <class T, class R, class F>
+	void continueWith(StateRef<T>& state, ULMTTools::Promise<R>& promise, F& func)
+	{
+		if (std::exception_ptr exception = state->exception())
+			promise.set_exception(exception);
+		else if constexpr (std::is_void_v<T>)
+			fulfil(promise, func);
+		else
+			fulfil(promise, func, std::move(state->value()));
+
+		state.reset();
+	}
+}
+
+namespace ULMTTools
+{
+	//Result of a Promise, i.e. of a task run through submit(), move only
+	//get() blocks till the result is available and consumes it, then() chains work to be done with it
+	template <class T>
+	class Future
+	{
+		static_assert(!std::is_reference_v<T>, "Future of a reference is not supported");
+
+		template <class>
+		friend class Future;
+		template <class>
+		friend class Promise;
+		template <class U>
+		friend Future<std::vector<Future<U>>> when_all(std::vector<Future<U>> futures);
+		template <class U>
+		friend Future<WhenAnyResult<U>> when_any(std::vector<Future<U>> futures);
+
+		mtInternalUtils::StateRef<T> m_state;
+
+		explicit Future(mtInternalUtils::StateRef<T>&& state) : m_state(std::move(state))
+		{
+		}
+
+		void checkValid() const
+		{
+			if (!m_state)
+				throw std::future_error(std::future_errc::no_state);
+		}
+
+	public:
+		Future()
+		{
+		}
+
+		Future(Future&&) noexcept = default;
+		Future& operator=(Future&&) noexcept = default;
+
+		//false for a default constructed future and after get() or then()
+		bool valid() const
+		{
+			return static_cast<bool>(m_state);
+		}
+
+		bool ready() const
+		{
+			checkValid();
+			return m_state->ready();
+		}
+
+		void wait() const
+		{
+			checkValid();
+			m_state->wait();
+		}
+
+		//Returns true if the result is available
+		template <class Clock, class Duration>
+		bool wait_until(const std::chrono::time_point<Clock, Duration>& deadline) const
+		{
+			checkValid();
+			return m_state->waitUntil(deadline);
+		}
+
+		template <class Rep, class Period>
+		bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const
+		{
+			return wait_until(std::chrono::steady_clock::now() + timeout);
+		}
+
+		//Waits for the result and moves it out, rethrows if the task threw, the future is invalid afterwards
+		T get()
+		{
+			checkValid();
+			m_state->wait();
+			mtInternalUtils::StateRef<T> state(std::move(m_state));
+			if constexpr (std::is_void_v<T>)
+				state->value();
+			else
+				return std::move(state->value());
+		}
+
+		//'func' is called with the result(nothing for Future<void>) and its own result goes to the returned future
+		//It runs inline on the thread completing this future, i.e. on the worker that ran the task, or right away
+		//on this thread if the result is already available, so it should be short
+		//If this future holds an exception, 'func' is skipped and the exception is passed on to the returned future
+		template <class F>
+		auto then(F&& func) -> Future<typename mtInternalUtils::ContinuationResult<T, std::decay_t<F>>::type>
+		{
+			typedef typename mtInternalUtils::ContinuationResult<T, std::decay_t<F>>::type R;
+			checkValid();
+
+			Promise<R> promise;
+			Future<R> result = promise.get_future();
+			mtInternalUtils::SharedState<T>* rawState = m_state.get();
+			rawState->onReady([state = std::move(m_state), promise = std::move(promise), func = std::forward<F>(func)]() mutable
+				{
+					mtInternalUtils::continueWith(state, promise, func);
+				});
+
+			return result;
+		}
+
+		//Same as above but 'func' runs on 'executor'(a WorkerThread, ThreadPool or anything with a push(Task&&)),
+		//for continuations too long to hold up the completing thread with
+		//'executor' is kept by reference till this future completes and has to outlive that moment, a killed but not yet
+		//destroyed executor is fine as its refusal breaks the returned future
+		template <class Executor, class F>
+		auto then(Executor& executor, F&& func) -> Future<typename mtInternalUtils::ContinuationResult<T, std::decay_t<F>>::type>
+		{
+			typedef typename mtInternalUtils::ContinuationResult<T, std::decay_t<F>>::type R;
+			checkValid();
+
+			Promise<R> promise;
+			Future<R> result = promise.get_future();
+			mtInternalUtils::SharedState<T>* rawState = m_state.get();
+			rawState->onReady([&executor, state = std::move(m_state), promise = std::move(promise), func = std::forward<F>(func)]() mutable
+				{
+					try
+					{
+						executor.push([state = std::move(state), promise = std::move(promise), func = std::move(func)]() mutable
+							{
+								mtInternalUtils::continueWith(state, promise, func);
+							});
+					}
+					catch (...)
+					{
+						//The executor refused the task(e.g. it has been killed), destroying the task broke the promise
+						//which is what the returned future reports, the completing thread has nothing to do with it
+					}
+				});
+
+			return result;
+		}
+	};
+
+	//Producer side of a Future, destroying it without setting a value or an exception
+	//makes the Future throw std::future_error(broken_promise)
+	template <class T>
+	class Promise
+	{
+		mtInternalUtils::StateRef<T> m_state;
+		bool m_futureRetrieved;
+
+	public:
+		Promise() : m_state(mtInternalUtils::SharedState<T>::acquire()), m_futureRetrieved(false)
+		{
+		}
+
+		Promise(Promise&& other) noexcept : m_state(std::move(other.m_state)), m_futureRetrieved(other.m_futureRetrieved)
+		{
+		}
+
+		Promise& operator=(Promise&& other) noexcept
+		{
+			if (this != &other)
+			{
+				abandon();
+				m_state = std::move(other.m_state);
+				m_futureRetrieved = other.m_futureRetrieved;
+			}
+
+			return *this;
+		}
+
+		Promise(const Promise&) = delete;
+		Promise& operator=(const Promise&) = delete;
+
+		Future<T> get_future()
+		{
+			if (!m_state)
+				throw std::future_error(std::future_errc::no_state);
+			if (m_futureRetrieved)
+				throw std::future_error(std::future_errc::future_already_retrieved);
+
+			m_futureRetrieved = true;
+			return Future<T>(m_state.share());
+		}
+
+		template <class... Args>
+		void set_value(Args&&... args)
+		{
+			if (!m_state)
+				throw std::future_error(std::future_errc::no_state);
+
+			m_state->setValue(std::forward<Args>(args)...);
+		}
+
+		void set_exception(std::exception_ptr exception)
+		{
+			if (!m_state)
+				throw std::future_error(std::future_errc::no_state);
+
+			m_state->setException(std::move(exception));
+		}
+
+		~Promise()
+		{
+			abandon();
+		}
+
+	private:
+		void abandon()
+		{
+			if (m_state && !m_state->ready())
+				m_state->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+
+			m_state.reset();
+		}
+	};
+
+	//Returns a future that becomes ready once all of 'futures' are, holding them all, each then being ready
+	//An exception in any of them doesn't fail the combined future, it stays inside the future it belongs to
+	template <class T>
+	Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures)
+	{
+		struct Context
+		{
+			std::vector<Future<T>> m_futures;
+			std::atomic<size_t> m_numPending;
+			Promise<std::vector<Future<T>>> m_promise;
+		};
+
+		for (auto& future : futures)
+			future.checkValid();
+
+		auto context = std::make_shared<Context>();
+		Future<std::vector<Future<T>>> result = context->m_promise.get_future();
+		if (futures.empty())
+		{
+			context->m_promise.set_value();
+			return result;
+		}
+
+		//The last one to complete moves the futures out of the context, so take the states before attaching anything
+		std::vector<mtInternalUtils::SharedState<T>*> states;
+		for (auto& future : futures)
+			states.push_back(future.m_state.get());
+
+		context->m_numPending = futures.size();
+		context->m_futures = std::move(futures);
+		for (auto* state : states)
+			state->onReady([context]()
+				{
+					if (1 == context->m_numPending.fetch_sub(1))
+						context->m_promise.set_value(std::move(context->m_futures));
+				});
+
+		return result;
+	}
+
+	//Returns a future that becomes ready as soon as any of 'futures' is, holding them all along with the index of that one
+	template <class T>
+	Future<WhenAnyResult<T>> when_any(std::vector<Future<T>> futures)
+	{
+		struct Context
+		{
+			std::vector<Future<T>> m_futures;
+			std::atomic<bool> m_done;
+			Promise<WhenAnyResult<T>> m_promise;
+		};
+
+		for (auto& future : futures)
+			future.checkValid();
+
+		auto context = std::make_shared<Context>();
+		Future<WhenAnyResult<T>> result = context->m_promise.get_future();
+		if (futures.empty())
+		{
+			context->m_promise.set_value(WhenAnyResult<T>{ static_cast<size_t>(-1), {} });
+			return result;
+		}
+
+		std::vector<mtInternalUtils::SharedState<T>*> states;
+		for (auto& future : futures)
+			states.push_back(future.m_state.get());
+
+		context->m_done = false;
+		context->m_futures = std::move(futures);
+		for (size_t i = 0; i < states.size(); i++)
+			states[i]->onReady([context, i]()
+				{
+					if (!context->m_done.exchange(true))
+						context->m_promise.set_value(WhenAnyResult<T>{ i, std::move(context->m_futures) });
+				});
+
+		return result;
+	}
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace mtInternalUtils
+{
+	//Intrusive multi producer/single consumer queue(Dmitry Vyukov's design)
+	//push() is wait-free for producers, consume() and empty() must only be called from the single consumer thread
+	//The order in which items are consumed is the order in which the producers' exchanges on m_tail were serialized
+	//Every item takes a node from the heap, allocated by its producer and freed by the consumer once the item has been
+	//consumed, recycling the nodes would need a free list that several producers pop from, i.e. ABA protection and
+	//a CAS loop, so producers would no longer be wait-free and the allocator's per thread caches are left to do that job
+	template <class T>
+	class MPSCQueue
+	{
+		struct Node
+		{
+			std::atomic<Node*> m_next;
+			alignas(T) unsigned char m_storage[sizeof(T)];
+
+			Node() : m_next(nullptr)
+			{
+			}
+
+			T* item()
+			{
+				return std::launder(reinterpret_cast<T*>(m_storage));
+			}
+		};
+
+		//Producers and consumer touch different ends of the list, keep them on different cache lines
+		alignas(64) std::atomic<Node*> m_tail;
+		alignas(64) Node* m_head;//Always points to the stub node, i.e. the node whose item has already been consumed
+
+		void link(Node* first, Node* last)
+		{
+			Node* prev = m_tail.exchange(last, std::memory_order_acq_rel);
+			//Between the exchange and this store the queue looks empty to the consumer from 'prev' onwards,
+			//the caller is responsible for waking up the consumer only after this store
+			prev->m_next.store(first, std::memory_order_release);
+		}
+
+	public:
+		MPSCQueue()
+		{
+			m_head = new Node();
+			m_tail.store(m_head, std::memory_order_relaxed);
+		}
+
+		MPSCQueue(const MPSCQueue&) = delete;
+		MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			std::unique_ptr<Node> node = std::make_unique<Node>();
+			new (node->m_storage) T(std::forward<Args>(args)...);
+			link(node.get(), node.get());
+			node.release();
+		}
+
+		void push(const T& item)
+		{
+			emplace(item);
+		}
+
+		void push(T&& item)
+		{
+			emplace(std::move(item));
+		}
+
+		//Moves all the items in [first, last) into the queue with a single exchange on m_tail, so the batch
+		//stays contiguous even if other producers are pushing at the same time, returns the number of items pushed
+		//If moving an item throws, none of the batch is queued and the items already moved out of the range are destroyed
+		template <class It>
+		size_t pushRange(It first, It last)
+		{
+			Node* head = nullptr;
+			Node* tail = nullptr;
+			size_t numItems = 0;
+			try
+			{
+				for (; first != last; ++first, ++numItems)
+				{
+					std::unique_ptr<Node> node = std::make_unique<Node>();
+					new (node->m_storage) T(std::move(*first));
+					if (tail)
+						tail->m_next.store(node.get(), std::memory_order_relaxed);
+					else
+						head = node.get();
+					tail = node.release();
+				}
+			}
+			catch (...)
+			{
+				//Nothing has been linked yet, so the partial chain is still ours alone
+				while (head)
+				{
+					Node* next = head->m_next.load(std::memory_order_relaxed);
+					head->item()->~T();
+					delete head;
+					head = next;
+				}
+				throw;
+			}
+
+			if (head)
+				link(head, tail);
+
+			return numItems;
+		}
+
+		//Consumer side, returns true if there is nothing to consume right now
+		//Note that an item whose producer is in the middle of push() is not visible yet
+		bool empty() const
+		{
+			return nullptr == m_head->m_next.load(std::memory_order_acquire);
+		}
+
+		//Consumer side, invokes 'processor' on every item visible at the moment, upto 'maxItems' of them
+		//and returns the number of items consumed
+		//If 'processor' throws, the item it was given is destroyed and counted as consumed, the queue stays usable
+		//and the exception propagates, so a caller which needs the count then has to keep it in 'processor'
+		template <class Processor>
+		size_t consume(Processor&& processor, size_t maxItems = static_cast<size_t>(-1))
+		{
+			size_t numConsumed = 0;
+			Node* next = numConsumed < maxItems ? m_head->m_next.load(std::memory_order_acquire) : nullptr;
+			while (nullptr != next)
+			{
+				//'next' becomes the new stub once its item is taken out
+				delete m_head;
+				m_head = next;
+
+				//Destroys the item even if 'processor' throws, it has already been unlinked
+				struct ItemGuard
+				{
+					T* m_item;
+					size_t& m_numConsumed;
+
+					~ItemGuard()
+					{
+						m_item->~T();
+						++m_numConsumed;
+					}
+				} guard{ next->item(), numConsumed };
+
+				processor(*guard.m_item);
+
+				next = numConsumed < maxItems ? m_head->m_next.load(std::memory_order_acquire) : nullptr;
+			}
+
+			return numConsumed;
+		}
+
+		~MPSCQueue()
+		{
+			consume([](T&) {});
+			delete m_head;
+		}
+	};
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Event.hpp"
+
+namespace mtInternalUtils
+{
+	//State of one parallel loop over [first, last), shared by its caller and the helper tasks it pushed to the pool
+	//Every participant claims chunks off a shared index till there are none left, a chunk being a share of what remains
+	//(guided self scheduling), so chunks start large and shrink down to 'grain' towards the end for a balanced finish
+	//The caller works on the loop as well, so a loop started from a pool's own worker never waits on a worker that isn't coming
+	template <class Body>
+	class ParallelLoop
+	{
+		//Set on m_numHelpers once the caller stops waiting for helpers, a helper starting after that leaves without touching anything
+		static constexpr size_t closedBit = static_cast<size_t>(1) << (sizeof(size_t) * 8 - 1);
+
+		Body& m_body;//Lives on the caller's stack, only touched by the helpers that joined before the caller closed the loop
+		std::atomic<size_t> m_next;
+		const size_t m_last;
+		const size_t m_grain;
+		const size_t m_numParticipants;
+		std::atomic<size_t> m_numHelpers;
+		Event m_helpersDone;
+		std::atomic<bool> m_failed;
+		std::exception_ptr m_exception;
+
+		bool claim(size_t& begin, size_t& end)
+		{
+			size_t next = m_next.load(std::memory_order_relaxed);
+			size_t remaining = next < m_last ? m_last - next : 0;
+			size_t chunkSize = std::max(m_grain, remaining / (2 * m_numParticipants));
+			begin = m_next.fetch_add(chunkSize, std::memory_order_relaxed);
+			if (begin >= m_last)
+				return false;
+
+			end = std::min(m_last, begin + chunkSize);
+			return true;
+		}
+
+	public:
+		ParallelLoop(Body& body, size_t first, size_t last, size_t grain, size_t numParticipants) :
+			m_body(body),
+			m_last(last),
+			m_grain(std::max<size_t>(grain, 1)),
+			m_numParticipants(numParticipants)
+		{
+			m_next = first;
+			m_numHelpers = 0;
+			m_failed = false;
+		}
+
+		void work()
+		{
+			size_t begin = 0;
+			size_t end = 0;
+			while (claim(begin, end))
+			{
+				try
+				{
+					m_body(begin, end);
+				}
+				catch (...)
+				{
+					//The first exception wins and the rest of the loop is called off
+					if (!m_failed.exchange(true))
+						m_exception = std::current_exception();
+					m_next.store(m_last, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		//Helper side, returns false if the caller is already done, in which case the helper must not call work()
+		bool join()
+		{
+			if (m_numHelpers.fetch_add(1, std::memory_order_acquire) & closedBit)
+			{
+				//The caller may have seen our increment, undo it the same way a finishing helper would
+				leave();
+				return false;
+			}
+
+			return true;
+		}
+
+		void leave()
+		{
+			if ((closedBit | 1) == m_numHelpers.fetch_sub(1, std::memory_order_acq_rel))
+				m_helpersDone.notify();
+		}
+
+		//Caller side, after its own work() returned, waits only for the helpers that joined in the meantime
+		void closeAndWait()
+		{
+			m_numHelpers.fetch_or(closedBit, std::memory_order_acq_rel);
+			while (closedBit != m_numHelpers.load(std::memory_order_acquire))
+				m_helpersDone.wait();
+
+			if (m_failed)
+				std::rethrow_exception(m_exception);
+		}
+	};
+
+	//Runs body(begin, end) over chunks covering [first, last) on the calling thread plus upto 'numWorkers' tasks pushed to 'executor'
+	template <class Executor, class Body>
+	void parallelChunks(Executor& executor, size_t numWorkers, size_t first, size_t last, size_t grain, Body& body)
+	{
+		if (first >= last)
+			return;
+
+		grain = std::max<size_t>(grain, 1);
+		size_t numChunks = (last - first + grain - 1) / grain;
+		size_t numHelpers = std::min(numWorkers, numChunks - 1);
+		auto loop = std::make_shared<ParallelLoop<Body>>(body, first, last, grain, numHelpers + 1);
+		for (size_t i = 0; i < numHelpers; i++)
+		{
+			try
+			{
+				executor.push([loop]()
+					{
+						if (loop->join())
+						{
+							loop->work();
+							loop->leave();
+						}
+					});
+			}
+			catch (...)
+			{
+				//An executor refusing tasks(e.g. killed) just leaves more of the loop to the caller
+				break;
+			}
+		}
+
+		loop->work();
+		loop->closeAndWait();
+	}
+
+	template <class Tuple, size_t... Is>
+	void invokeAt(Tuple& funcs, size_t idx, std::index_sequence<Is...>)
+	{
+		((Is == idx ? (void)std::get<Is>(funcs)() : (void)0), ...);
+	}
+}
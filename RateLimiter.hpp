@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <CommonUtils/CommonDefs.hpp>
+#include <CommonUtils/RingBuffer.hpp>
+
+namespace mtInternalUtils
+{
+	//How a throttler keeps to its bandwidth
+	enum class ThrottlingMode
+	{
+		SlidingWindow,//Never more than numTransactions in any unitTime, keeping the time of each of the last numTransactions
+		TokenBucket//GCRA, one transaction every unitTime / numTransactions with upto 'burst' back to back, in constant memory
+	};
+
+	//numTransactions per unitTime
+	struct RateLimit
+	{
+		duration unitTime;
+		size_t numTransactions;
+		ThrottlingMode mode;
+		//ThrottlingMode::TokenBucket, the transactions that may go back to back after an idle period, so any unitTime
+		//sees upto numTransactions + burst - 1 of them. 1 spaces them evenly, never more than numTransactions in a unitTime
+		size_t burst;
+
+		RateLimit(const duration& unitTime, size_t numTransactions, ThrottlingMode mode = ThrottlingMode::SlidingWindow, size_t burst = 1) :
+			unitTime(unitTime), numTransactions(numTransactions), mode(mode), burst(burst)
+		{}
+	};
+
+	//Tells when the next transaction may go ahead as per one RateLimit, see RateLimiter
+	class SingleRateLimiter
+	{
+		ThrottlingMode m_mode;
+		duration m_unitTime;
+		//SlidingWindow
+		std::optional<ULCommonUtils::RingBuffer<time_point>> m_transactionLog;
+		//TokenBucket
+		duration m_emissionInterval = duration::zero();//unitTime / numTransactions, rounded up so as never to go over the rate
+		duration m_tolerance = duration::zero();//(burst - 1) emission intervals
+		time_point m_theoreticalArrival;//When the next transaction would be due if they were evenly spaced
+
+	public:
+		//Throws std::invalid_argument for a limit allowing nothing
+		explicit SingleRateLimiter(const RateLimit& limit) :
+			m_mode(limit.mode),
+			m_unitTime(limit.unitTime)
+		{
+			if (limit.unitTime <= duration::zero() || !limit.numTransactions)
+				throw std::invalid_argument("A rate limit needs a positive unit time and number of transactions");
+
+			if (ThrottlingMode::SlidingWindow == m_mode)
+			{
+				m_transactionLog.emplace(limit.numTransactions);
+				return;
+			}
+
+			if (!limit.burst)
+				throw std::invalid_argument("The burst of a token bucket has to be at least 1");
+
+			auto numTransactions = static_cast<duration::rep>(limit.numTransactions);
+			m_emissionInterval = duration((limit.unitTime.count() + numTransactions - 1) / numTransactions);
+			m_tolerance = m_emissionInterval * static_cast<duration::rep>(limit.burst - 1);
+		}
+
+		//The earliest time, not before 'now', at which the next transaction may go ahead, any time after it as well
+		time_point availableAt(const time_point& now)
+		{
+			if (ThrottlingMode::TokenBucket == m_mode)
+				return std::max(now, m_theoreticalArrival - m_tolerance);
+
+			if (m_transactionLog->full() && now - m_transactionLog->front() <= m_unitTime)
+				return m_transactionLog->front() + m_unitTime;
+
+			return now;
+		}
+
+		void record(const time_point& now)
+		{
+			if (ThrottlingMode::TokenBucket == m_mode)
+				m_theoreticalArrival = std::max(m_theoreticalArrival, now) + m_emissionInterval;
+			else
+				m_transactionLog->push(now);
+		}
+	};
+
+	//Tells when the next transaction may go ahead as per all of its limits together, e.g. 50 per 100ms and 2000 per
+	//minute as exchanges impose them, the throttler records each transaction it lets through
+	//Not thread safe, it belongs to the throttler's thread
+	class RateLimiter
+	{
+		std::vector<SingleRateLimiter> m_limiters;
+
+	public:
+		explicit RateLimiter(const RateLimit& limit)
+		{
+			m_limiters.emplace_back(limit);
+		}
+
+		//Throws std::invalid_argument for no limits or one allowing nothing
+		explicit RateLimiter(const std::vector<RateLimit>& limits)
+		{
+			if (limits.empty())
+				throw std::invalid_argument("A throttler needs at least one rate limit");
+
+			m_limiters.reserve(limits.size());
+			for (auto& limit : limits)
+				m_limiters.emplace_back(limit);
+		}
+
+		//The latest of the times the limits allow, as each of them allows any time after its own
+		time_point availableAt(const time_point& now)
+		{
+			time_point available = now;
+			for (auto& limiter : m_limiters)
+				available = std::max(available, limiter.availableAt(now));
+			return available;
+		}
+
+		void record(const time_point& now)
+		{
+			for (auto& limiter : m_limiters)
+				limiter.record(now);
+		}
+	};
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "MPSCQueue.hpp"
+#include "ThreadPool.hpp"
+
+namespace ULMTTools
+{
+	//Serial executor on top of a ThreadPool: the tasks pushed to a strand run one at a time and in the order they were pushed,
+	//same as on a WorkerThread, but on whichever worker of the pool picks them up instead of on a thread of its own
+	//An idle strand costs no CPU at all and a few hundred bytes of memory, so there can be one per key(instrument, session...)
+	//The strand has to outlive the tasks pushed to it, the destructor waits for them and so must not run on the strand itself
+	class Strand
+	{
+		//No. of tasks run in one go before the strand goes to the back of the pool's queue, so that a busy strand
+		//doesn't hold up the other strands sharing its worker
+		static constexpr size_t maxBatch = 64;
+
+		ThreadPool& m_pool;
+		mtInternalUtils::MPSCQueue<Task> m_queue;
+		//Tasks pushed and not yet run, the push taking it from 0 schedules the strand on the pool and the strand stays
+		//scheduled till it brings it back to 0, so it is never on more than one worker at a time
+		std::atomic<size_t> m_numPending;
+
+		void scheduleOnPool()
+		{
+			m_pool.push([this]() { drain(); });
+		}
+
+		void drain()
+		{
+			//Every counted task has been linked into the queue before being counted, yet one linked behind a producer still
+			//in the middle of its push isn't reachable so fewer may run, the ones left counted then reschedule the strand
+			size_t numToRun = std::min(m_numPending.load(std::memory_order_acquire), maxBatch);
+			size_t numRun = m_queue.consume([](Task& task) { task(); }, numToRun);
+			if (m_numPending.fetch_sub(numRun, std::memory_order_acq_rel) != numRun)
+				scheduleOnPool();
+		}
+
+		template <class... Args>
+		void emplaceImpl(Args&&... args)
+		{
+			m_queue.emplace(std::forward<Args>(args)...);
+			if (0 == m_numPending.fetch_add(1, std::memory_order_acq_rel))
+				scheduleOnPool();
+		}
+
+	public:
+		explicit Strand(ThreadPool& pool) : m_pool(pool)
+		{
+			m_numPending = 0;
+		}
+
+		Strand(const Strand&) = delete;
+		Strand& operator=(const Strand&) = delete;
+
+		void push(Task&& task)
+		{
+			emplaceImpl(std::move(task));
+		}
+
+		template <class F>
+		void emplace(F&& func)
+		{
+			emplaceImpl(std::forward<F>(func));
+		}
+
+		template <class F>
+		auto submit(F&& func)
+		{
+			return mtInternalUtils::submit(*this, std::forward<F>(func));
+		}
+
+		//co_await strand.schedule() continues the coroutine on the strand, i.e. serialized with its other tasks
+		mtInternalUtils::ScheduleAwaitable<Strand> schedule()
+		{
+			return mtInternalUtils::ScheduleAwaitable<Strand>(*this);
+		}
+
+		//returns number of pending tasks
+		size_t size() const
+		{
+			return m_numPending.load();
+		}
+
+		~Strand()
+		{
+			while (m_numPending.load())
+				std::this_thread::yield();
+		}
+	};
+	DEFINE_PTR(Strand)
+
+	//Fixed set of strands on one ThreadPool with keys hashed onto them, tasks for the same key run in order and never concurrently
+	//Distinct keys may share a strand, so a slow task delays the other keys on its strand, more strands means less of that
+	template <class Key, class Hash = std::hash<Key>>
+	class StrandGroup
+	{
+		std::vector<std::unique_ptr<Strand>> m_strands;
+		Hash m_hash;
+
+	public:
+		StrandGroup(ThreadPool& pool, size_t numStrands, const Hash& hash = Hash()) : m_hash(hash)
+		{
+			if (!numStrands)
+				throw std::invalid_argument("A StrandGroup needs at least 1 strand");
+
+			m_strands.reserve(numStrands);
+			for (size_t i = 0; i < numStrands; i++)
+				m_strands.push_back(std::make_unique<Strand>(pool));
+		}
+
+		Strand& strand(const Key& key)
+		{
+			return *m_strands[m_hash(key) % m_strands.size()];
+		}
+
+		void push(const Key& key, Task&& task)
+		{
+			strand(key).push(std::move(task));
+		}
+
+		template <class F>
+		void emplace(const Key& key, F&& func)
+		{
+			strand(key).emplace(std::forward<F>(func));
+		}
+
+		size_t numStrands() const
+		{
+			return m_strands.size();
+		}
+	};
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//Size of the buffer a Task keeps its callable in, callables that don't fit(or can't be moved without throwing) go to the heap
+#ifndef MTTOOLS_TASK_INLINE_SIZE
+#define MTTOOLS_TASK_INLINE_SIZE 64
+#endif
+
+namespace mtInternalUtils
+{
+	//Move only, type erased "void()" callable
+	//Unlike std::function it doesn't require the callable to be copyable and keeps callables of upto InlineSize bytes
+	//inside the object itself, so pushing a lambda capturing a few pointers and a shared_ptr doesn't allocate
+	template <size_t InlineSize>
+	class InplaceTask
+	{
+		struct Operations
+		{
+			void (*invoke)(void* storage);
+			void (*moveTo)(void* from, void* to);//moves the callable from 'from' to 'to' and destroys the one in 'from'
+			void (*destroy)(void* storage);
+		};
+
+		template <class F>
+		static constexpr bool fitsInline()
+		{
+			return sizeof(F) <= InlineSize &&
+				alignof(F) <= alignof(std::max_align_t) &&
+				std::is_nothrow_move_constructible_v<F>;
+		}
+
+		template <class F>
+		struct InlineOperations
+		{
+			static F* get(void* storage)
+			{
+				return std::launder(reinterpret_cast<F*>(storage));
+			}
+
+			static void invoke(void* storage)
+			{
+				(*get(storage))();
+			}
+
+			static void moveTo(void* from, void* to)
+			{
+				new (to) F(std::move(*get(from)));
+				get(from)->~F();
+			}
+
+			static void destroy(void* storage)
+			{
+				get(storage)->~F();
+			}
+
+			static constexpr Operations s_operations = { &invoke, &moveTo, &destroy };
+		};
+
+		template <class F>
+		struct HeapOperations
+		{
+			static F*& get(void* storage)
+			{
+				return *std::launder(reinterpret_cast<F**>(storage));
+			}
+
+			static void invoke(void* storage)
+			{
+				(*get(storage))();
+			}
+
+			static void moveTo(void* from, void* to)
+			{
+				new (to) F*(get(from));
+			}
+
+			static void destroy(void* storage)
+			{
+				delete get(storage);
+			}
+
+			static constexpr Operations s_operations = { &invoke, &moveTo, &destroy };
+		};
+
+		alignas(std::max_align_t) unsigned char m_storage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+		const Operations* m_operations;
+
+		void reset()
+		{
+			if (m_operations)
+			{
+				m_operations->destroy(m_storage);
+				m_operations = nullptr;
+			}
+		}
+
+	public:
+		InplaceTask() : m_operations(nullptr)
+		{
+		}
+
+		InplaceTask(std::nullptr_t) : m_operations(nullptr)
+		{
+		}
+
+		template <class F,
+			class Callable = std::decay_t<F>,
+			class = std::enable_if_t<!std::is_same_v<Callable, InplaceTask> && std::is_invocable_v<Callable&>>>
+		InplaceTask(F&& func)
+		{
+			if constexpr (fitsInline<Callable>())
+			{
+				new (m_storage) Callable(std::forward<F>(func));
+				m_operations = &InlineOperations<Callable>::s_operations;
+			}
+			else
+			{
+				new (m_storage) Callable*(new Callable(std::forward<F>(func)));
+				m_operations = &HeapOperations<Callable>::s_operations;
+			}
+		}
+
+		InplaceTask(InplaceTask&& other) noexcept : m_operations(other.m_operations)
+		{
+			if (m_operations)
+			{
+				m_operations->moveTo(other.m_storage, m_storage);
+				other.m_operations = nullptr;
+			}
+		}
+
+		InplaceTask& operator=(InplaceTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				if (other.m_operations)
+				{
+					other.m_operations->moveTo(other.m_storage, m_storage);
+					m_operations = other.m_operations;
+					other.m_operations = nullptr;
+				}
+			}
+
+			return *this;
+		}
+
+		InplaceTask(const InplaceTask&) = delete;
+		InplaceTask& operator=(const InplaceTask&) = delete;
+
+		void operator()()
+		{
+			if (!m_operations)
+				throw std::bad_function_call();
+			m_operations->invoke(m_storage);
+		}
+
+		explicit operator bool() const
+		{
+			return nullptr != m_operations;
+		}
+
+		~InplaceTask()
+		{
+			reset();
+		}
+	};
+}
+
+typedef mtInternalUtils::InplaceTask<MTTOOLS_TASK_INLINE_SIZE> Task;
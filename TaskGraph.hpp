@@ -0,0 +1,236 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "ThreadPool.hpp"
+
+namespace ULMTTools
+{
+	//Directed acyclic graph of tasks run on a ThreadPool, a node runs once all the nodes it depends on have finished
+	//Every node has an atomic counter of the dependencies yet to finish, the dependency taking it to 0 launches the node,
+	//so successors start as soon as their inputs are done without anyone waiting on them
+	//The graph is built once and run as many times as needed, a run only resets the counters in place
+	//The graph has to outlive its runs, the destructor waits for the current one and so must not run on the graph itself
+	class TaskGraph
+	{
+	public:
+		typedef size_t NodeId;
+
+	private:
+		struct Node
+		{
+			Task m_task;
+			std::vector<NodeId> m_successors;
+			size_t m_numPredecessors;
+			std::atomic<size_t> m_numPending;//Predecessors yet to finish in the current run
+
+			explicit Node(Task&& task) : m_task(std::move(task)), m_numPredecessors(0)
+			{
+				m_numPending = 0;
+			}
+		};
+
+		ThreadPool& m_pool;
+		std::deque<Node> m_nodes;//A deque as the nodes, holding atomics, can't be moved
+		std::vector<NodeId> m_roots;//Nodes without predecessors, valid when !m_modified
+		bool m_modified;//Since the last check for cycles
+
+		std::atomic<size_t> m_numRemaining;//Nodes yet to finish in the current run
+		std::atomic<bool> m_running;
+		std::atomic<bool> m_failed;
+		std::exception_ptr m_exception;
+		Promise<void> m_promise;
+
+		void checkNotRunning() const
+		{
+			if (m_running)
+				throw std::logic_error("A TaskGraph can't be changed or run again while it is running");
+		}
+
+		void fail(std::exception_ptr exception)
+		{
+			if (!m_failed.exchange(true))
+				m_exception = exception;
+		}
+
+		//Finds the roots, and throws std::logic_error if the edges make a cycle(Kahn's algorithm)
+		void validate()
+		{
+			std::vector<size_t> numPending(m_nodes.size());
+			std::vector<NodeId> ready;
+			m_roots.clear();
+			for (NodeId id = 0; id < m_nodes.size(); id++)
+			{
+				numPending[id] = m_nodes[id].m_numPredecessors;
+				if (!numPending[id])
+					m_roots.push_back(id);
+			}
+
+			ready = m_roots;
+			size_t numVisited = 0;
+			while (!ready.empty())
+			{
+				NodeId id = ready.back();
+				ready.pop_back();
+				numVisited++;
+				for (NodeId successor : m_nodes[id].m_successors)
+					if (0 == --numPending[successor])
+						ready.push_back(successor);
+			}
+
+			if (numVisited != m_nodes.size())
+				throw std::logic_error("The edges of the TaskGraph make a cycle");
+
+			m_modified = false;
+		}
+
+		void schedule(Node& node)
+		{
+			try
+			{
+				m_pool.push([this, &node]() { runFrom(node); });
+			}
+			catch (...)
+			{
+				//The pool refuses tasks(e.g. killed), the rest of the run is skipped right here so that it still completes
+				fail(std::current_exception());
+				runFrom(node);
+			}
+		}
+
+		//Runs 'node', then keeps going with one of the successors it makes ready and pushes the others to the pool
+		//so a chain of nodes runs on one thread without a trip through the pool's queue per node
+		void runFrom(Node& first)
+		{
+			Node* node = &first;
+			while (node)
+			{
+				//After a failure the remaining nodes are only counted down, not run
+				if (!m_failed.load(std::memory_order_relaxed))
+				{
+					try
+					{
+						node->m_task();
+					}
+					catch (...)
+					{
+						fail(std::current_exception());
+					}
+				}
+
+				Node* next = nullptr;
+				for (NodeId id : node->m_successors)
+				{
+					Node& successor = m_nodes[id];
+					if (1 == successor.m_numPending.fetch_sub(1, std::memory_order_acq_rel))
+					{
+						if (next)
+							schedule(successor);
+						else
+							next = &successor;
+					}
+				}
+
+				//A node with a successor still to run can't be the last one, so 'this' is only let go of once 'next' is null
+				if (1 == m_numRemaining.fetch_sub(1, std::memory_order_acq_rel))
+					complete();
+
+				node = next;
+			}
+		}
+
+		void complete()
+		{
+			Promise<void> promise = std::move(m_promise);
+			std::exception_ptr exception = m_failed ? m_exception : nullptr;
+			//The graph may be destroyed or run again right after this, so only locals from here on
+			m_running.store(false, std::memory_order_release);
+			if (exception)
+				promise.set_exception(exception);
+			else
+				promise.set_value();
+		}
+
+	public:
+		explicit TaskGraph(ThreadPool& pool) : m_pool(pool), m_modified(false)
+		{
+			m_numRemaining = 0;
+			m_running = false;
+			m_failed = false;
+		}
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+
+		NodeId add(Task&& task)
+		{
+			checkNotRunning();
+			m_nodes.emplace_back(std::move(task));
+			m_modified = true;
+			return m_nodes.size() - 1;
+		}
+
+		template <class F>
+		NodeId emplace(F&& func)
+		{
+			return add(Task(std::forward<F>(func)));
+		}
+
+		//'after' runs only once 'before' has finished
+		void addEdge(NodeId before, NodeId after)
+		{
+			checkNotRunning();
+			if (before >= m_nodes.size() || after >= m_nodes.size())
+				throw std::out_of_range("No such node in the TaskGraph");
+
+			m_nodes[before].m_successors.push_back(after);
+			m_nodes[after].m_numPredecessors++;
+			m_modified = true;
+		}
+
+		//Starts a run and returns right away, the future becomes ready once every node has finished
+		//The first exception thrown by a node skips the nodes that haven't started yet and ends up in the future
+		//Throws std::logic_error if the graph is still running or has a cycle
+		Future<void> run()
+		{
+			checkNotRunning();
+			if (m_modified)
+				validate();
+
+			m_promise = Promise<void>();
+			Future<void> future = m_promise.get_future();
+			if (m_nodes.empty())
+			{
+				m_promise.set_value();
+				return future;
+			}
+
+			m_failed = false;
+			m_exception = nullptr;
+			for (Node& node : m_nodes)
+				node.m_numPending.store(node.m_numPredecessors, std::memory_order_relaxed);
+			m_numRemaining.store(m_nodes.size(), std::memory_order_relaxed);
+			m_running.store(true, std::memory_order_release);
+
+			for (NodeId root : m_roots)
+				schedule(m_nodes[root]);
+
+			return future;
+		}
+
+		size_t size() const
+		{
+			return m_nodes.size();
+		}
+
+		~TaskGraph()
+		{
+			while (m_running.load(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+	};
+	DEFINE_PTR(TaskGraph)
+}
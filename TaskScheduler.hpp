@@ -3,21 +3,138 @@
 
 namespace ULMTTools
 {
+	typedef mtInternalUtils::TimerBackend TimerBackend;
+	typedef mtInternalUtils::SchedulerWakeup SchedulerWakeup;
+	typedef mtInternalUtils::SchedulerOptions SchedulerOptions;
+	typedef mtInternalUtils::TimerHandle TimerHandle;
+	typedef mtInternalUtils::SchedulerStats SchedulerStats;
+	typedef mtInternalUtils::OverrunPolicy OverrunPolicy;
+	typedef mtInternalUtils::PeriodicOptions PeriodicOptions;
+
+	//Runs a fired task somewhere else than on the scheduler thread, see TaskScheduler(executor) and Timer::install()
+	typedef std::function<void(Task&&)> TaskExecutor;
+
+	//Pushes the tasks to a WorkerThread, a ThreadPool or anything else with a push(Task&&), kept alive by the executor
+	template <class Executor>
+	TaskExecutor makeTaskExecutor(const std::shared_ptr<Executor>& executor)
+	{
+		return [executor](Task&& task) { executor->push(std::move(task)); };
+	}
+
 	class TaskScheduler
 	{
 		typedef std::pair<time_point, Task> TimeTaskPair;
 		typedef mtInternalUtils::Scheduler<Task> Scheduler;
 		DEFINE_UNIQUE_PTR(Scheduler)
 
+		TaskExecutor m_executor;//Empty if the tasks run on the scheduler thread
 			Scheduler m_timedConsumer;
 	public:
 
-		TaskScheduler() : m_timedConsumer([](Task task) {task(); })
+		TaskScheduler(const ThreadOptions& threadOptions = ThreadOptions()) :
+			m_timedConsumer([](Task&& task) {task(); }, [](Task& task) {task(); }, threadOptions)
+		{}
+
+		//SchedulerOptions::backend picks the storage of the pending tasks, see TimerBackend
+		explicit TaskScheduler(const SchedulerOptions& schedulerOptions, const ThreadOptions& threadOptions = ThreadOptions()) :
+			m_timedConsumer([](Task&& task) {task(); }, [](Task& task) {task(); }, threadOptions, schedulerOptions)
 		{}
 
-		virtual void push(const time_point& t, const Task& task)
+		//Fired tasks are handed to 'executor' instead of running on the scheduler thread, which then only keeps time, so
+		//a slow task delays neither the tasks due with it nor the following ones
+		explicit TaskScheduler(TaskExecutor executor, const SchedulerOptions& schedulerOptions = SchedulerOptions(), const ThreadOptions& threadOptions = ThreadOptions()) :
+			m_executor(std::move(executor)),
+			m_timedConsumer([this](Task&& task) {m_executor(std::move(task)); }, [](Task& task) {task(); }, threadOptions, schedulerOptions)
+		{}
+
+		template <class Executor>
+		explicit TaskScheduler(const std::shared_ptr<Executor>& executor, const SchedulerOptions& schedulerOptions = SchedulerOptions(), const ThreadOptions& threadOptions = ThreadOptions()) :
+			TaskScheduler(makeTaskExecutor(executor), schedulerOptions, threadOptions)
+		{}
+
+		//The handle can cancel the task till it starts running, see TimerHandle::cancel()
+		//The task may run upto SchedulerOptions::slack late
+		virtual TimerHandle push(const time_point& t, Task&& task)
+		{
+			return m_timedConsumer.push(t, std::move(task));
+		}
+
+		//The task may run anywhere in [t, t + slack], letting it share a wakeup with the tasks due around then
+		virtual TimerHandle push(const time_point& t, const duration& slack, Task&& task)
+		{
+			return m_timedConsumer.push(t, slack, std::move(task));
+		}
+
+		//Runs 'task' at 'first', 'first' + 'period', ... till the handle cancels it, see Scheduler::emplace_periodic()
+		//With an executor every run is handed to it, the task being shared by the runs rather than copied
+		virtual TimerHandle push_periodic(const time_point& first, const duration& period, Task&& task)
+		{
+			return push_periodic(first, period, m_timedConsumer.slack(), std::move(task));
+		}
+
+		virtual TimerHandle push_periodic(const time_point& first, const duration& period, const duration& slack, Task&& task)
+		{
+			PeriodicOptions options;
+			options.slack = slack;
+			return push_periodic(first, period, options, std::move(task));
+		}
+
+		//PeriodicOptions::slack is taken as is, SchedulerOptions::slack doesn't apply
+		//A scheduler with an executor only takes OverrunPolicy::CatchUp, see OverrunPolicy
+		virtual TimerHandle push_periodic(const time_point& first, const duration& period, const PeriodicOptions& options, Task&& task)
+		{
+			if (!m_executor)
+				return m_timedConsumer.emplace_periodic(first, period, options, std::move(task));
+
+			if (OverrunPolicy::CatchUp != options.overrun)
+				throw std::invalid_argument("Only OverrunPolicy::CatchUp applies to periodic tasks handed to an executor");
+
+			return m_timedConsumer.emplace_periodic(first, period, options, [this, shared = std::make_shared<Task>(std::move(task))]()
+				{
+					m_executor(Task([shared]() { (*shared)(); }));
+				});
+		}
+
+		//SchedulerOptions::slack
+		const duration& slack() const
+		{
+			return m_timedConsumer.slack();
+		}
+
+		SchedulerStats stats() const
+		{
+			return m_timedConsumer.stats();
+		}
+
+		//With SchedulerWakeup::TimerFd, an fd to add to an epoll loop(EPOLLIN), -1 otherwise
+		int fd() const
+		{
+			return m_timedConsumer.fd();
+		}
+
+		//With SchedulerOptions::externalLoop, runs the due tasks on the calling thread, to be called whenever fd() is readable
+		void poll()
+		{
+			m_timedConsumer.poll();
+		}
+
+		//Cancelled tasks still holding a slot in the scheduler's queue
+		size_t numCancelledResident() const
+		{
+			return m_timedConsumer.numCancelledResident();
+		}
+
+		//co_await scheduler.sleep_until(t) continues the coroutine at 't' wherever the scheduler runs its tasks, i.e. on the
+		//executor it was constructed with, if any, and on the scheduler's thread otherwise, which being the timer thread
+		//shouldn't be given more than a little work, hop to a worker with co_await worker.schedule() for the rest
+		mtInternalUtils::SleepAwaitable<TaskScheduler> sleep_until(const time_point& t)
+		{
+			return mtInternalUtils::SleepAwaitable<TaskScheduler>(*this, t);
+		}
+
+		mtInternalUtils::SleepAwaitable<TaskScheduler> sleep_for(const duration& interval)
 		{
-			m_timedConsumer.push(t, task);
+			return sleep_until(ULCommonUtils::now() + interval);
 		}
 	};
 	DEFINE_PTR(TaskScheduler)
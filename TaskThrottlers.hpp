@@ -4,6 +4,9 @@
 
 namespace ULMTTools
 {
+	typedef mtInternalUtils::ThrottlingMode ThrottlingMode;
+	typedef mtInternalUtils::RateLimit RateLimit;
+
 	class ThrottledWorkerThread
 	{
 		typedef mtInternalUtils::ThrottledConsumerThread<Task> ThrottledConsumerThread;
@@ -14,20 +17,76 @@ namespace ULMTTools
 
 	public:
 #if defined(ENABLE_MTTOOLS_TESTING)//This constructor is for testing purpose only, not available to the client code
-		ThrottledWorkerThread(std::shared_ptr<std::vector<Task>> queue, duration unitTime, size_t numTransactions, std::function<void(Task)> executor = [](Task task) {task(); })
-			:m_consumer(std::make_unique<ThrottledConsumerThread>(queue, executor, unitTime, numTransactions))
+		ThrottledWorkerThread(std::shared_ptr<std::vector<Task>> queue, duration unitTime, size_t numTransactions, std::function<void(Task&&)> executor = [](Task&& task) {task(); })
+			:m_consumer(std::make_unique<ThrottledConsumerThread>(queue, executor, std::vector<RateLimit>{ RateLimit(unitTime, numTransactions) }))
 		{
 		}
 #endif //ENABLE_MTTOOLS_TESTSING
 
-		ThrottledWorkerThread(const duration& unitTime, const size_t& numTransactions)
-			:m_consumer(std::make_unique<ThrottledConsumerThread>(std::make_shared<std::vector<Task>>(), [](Task task) {task(); }, unitTime, numTransactions))
+		//waitStrategy applies both to waiting for tasks and to waiting for the bandwidth to become available
+		ThrottledWorkerThread(const duration& unitTime,
+			const size_t& numTransactions,
+			WaitStrategy waitStrategy = WaitStrategy::Blocking,
+			const duration& spinDuration = std::chrono::microseconds(50),
+			const ThreadOptions& threadOptions = ThreadOptions())
+			:ThrottledWorkerThread(RateLimit(unitTime, numTransactions), waitStrategy, spinDuration, threadOptions)
+		{
+		}
+
+		//RateLimit::mode picks the sliding window(as above) or a token bucket, see ThrottlingMode
+		//Throws std::invalid_argument for a limit allowing nothing
+		explicit ThrottledWorkerThread(const RateLimit& limit,
+			WaitStrategy waitStrategy = WaitStrategy::Blocking,
+			const duration& spinDuration = std::chrono::microseconds(50),
+			const ThreadOptions& threadOptions = ThreadOptions())
+			:ThrottledWorkerThread(std::vector<RateLimit>{ limit }, waitStrategy, spinDuration, threadOptions)
+		{
+		}
+
+		//Keeps to all the limits together, e.g. 50 tasks per 100ms and 2000 per minute, each task waiting for the latest
+		//of the times they allow, without chaining a throttler per limit
+		//Throws std::invalid_argument for no limits or one allowing nothing
+		explicit ThrottledWorkerThread(const std::vector<RateLimit>& limits,
+			WaitStrategy waitStrategy = WaitStrategy::Blocking,
+			const duration& spinDuration = std::chrono::microseconds(50),
+			const ThreadOptions& threadOptions = ThreadOptions())
+			:m_consumer(std::make_unique<ThrottledConsumerThread>(std::make_shared<std::vector<Task>>(), [](Task&& task) {task(); }, limits, waitStrategy, spinDuration, threadOptions))
+		{
+		}
+
+		ThrottledWorkerThread(const duration& unitTime, const size_t& numTransactions, const ThreadOptions& threadOptions)
+			:ThrottledWorkerThread(unitTime, numTransactions, WaitStrategy::Blocking, std::chrono::microseconds(50), threadOptions)
+		{
+		}
+
+		void push(Task&& task)
+		{
+			m_consumer->push(std::move(task));
+		}
+
+		template <class F>
+		void emplace(F&& func)
+		{
+			m_consumer->emplace(std::forward<F>(func));
+		}
+
+		//The tasks in the range are moved from, throttling applies to each of them individually
+		template <class It>
+		void push_bulk(It first, It last)
 		{
+			m_consumer->push_bulk(first, last);
 		}
 
-		void push(const Task& task)
+		void push_bulk(std::span<Task> tasks)
 		{
-			m_consumer->push(task);
+			push_bulk(tasks.begin(), tasks.end());
+		}
+
+		//co_await throttler.acquire() continues the coroutine on the throttled thread once the bandwidth allows,
+		//i.e. the rest of the coroutine up to its next suspension counts as one transaction
+		mtInternalUtils::ScheduleAwaitable<ThrottledWorkerThread> acquire()
+		{
+			return mtInternalUtils::ScheduleAwaitable<ThrottledWorkerThread>(*this);
 		}
 
 		void kill()
@@ -47,13 +106,41 @@ namespace ULMTTools
 																	const std::shared_ptr<TaskScheduler> taskScheduler,
 																	const duration& unitTime,
 																	const size_t& numTransactions)
-			:m_consumer(std::make_unique<ReusableThrottler>(worker, taskScheduler, [](Task task) {task(); }, unitTime, numTransactions))
+			:ReusableThrottledWorkerThread(worker, taskScheduler, RateLimit(unitTime, numTransactions))
+		{
+		}
+
+		//See ThrottledWorkerThread(RateLimit)
+		ReusableThrottledWorkerThread(const std::shared_ptr<WorkerThread>& worker,
+																	const std::shared_ptr<TaskScheduler> taskScheduler,
+																	const RateLimit& limit)
+			:ReusableThrottledWorkerThread(worker, taskScheduler, std::vector<RateLimit>{ limit })
+		{
+		}
+
+		//See ThrottledWorkerThread(std::vector<RateLimit>)
+		ReusableThrottledWorkerThread(const std::shared_ptr<WorkerThread>& worker,
+																	const std::shared_ptr<TaskScheduler> taskScheduler,
+																	const std::vector<RateLimit>& limits)
+			:m_consumer(std::make_unique<ReusableThrottler>(worker, taskScheduler, [](Task&& task) {task(); }, limits))
+		{
+		}
+
+		void push(Task&& task)
+		{
+			m_consumer->push(std::move(task));
+		}
+
+		template <class F>
+		void emplace(F&& func)
 		{
+			m_consumer->emplace(std::forward<F>(func));
 		}
 
-		void push(const Task& task)
+		//Same as ThrottledWorkerThread::acquire(), the coroutine continues on the shared worker
+		mtInternalUtils::ScheduleAwaitable<ReusableThrottledWorkerThread> acquire()
 		{
-			m_consumer->push(task);
+			return mtInternalUtils::ScheduleAwaitable<ReusableThrottledWorkerThread>(*this);
 		}
 	};
 	DEFINE_PTR(ReusableThrottledWorkerThread)
@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "Task.hpp"
+
+#if defined(__linux__)
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mtInternalUtils
+{
+	enum class SchedulingPolicy
+	{
+		Default,//SCHED_OTHER, ThreadOptions::priority is the nice value
+		Fifo,//SCHED_FIFO, ThreadOptions::priority is the real time priority
+		RoundRobin//SCHED_RR, ThreadOptions::priority is the real time priority
+	};
+
+	//How an owned thread is to be set up before it starts running its loop
+	//Only applied on Linux, the thread is started with the platform's defaults elsewhere
+	struct ThreadOptions
+	{
+		std::vector<int> cores;//CPUs the thread may run on, empty means no restriction
+		std::string name;//Shows up in top, ps and the debugger, Linux keeps only the first 15 characters
+		SchedulingPolicy schedulingPolicy = SchedulingPolicy::Default;
+		int priority = 0;
+		size_t stackSize = 0;//0 means the platform's default
+	};
+
+	//Options for worker 'idx' of a pool set up with 'poolOptions', 'poolOptions.cores' being the core map(worker i runs on cores[i % cores.size()])
+	//and 'poolOptions.name', if given, suffixed with "-i", rest of the options apply to every worker as they are
+	inline ThreadOptions workerThreadOptions(const ThreadOptions& poolOptions, size_t idx)
+	{
+		ThreadOptions options = poolOptions;
+		if (!poolOptions.cores.empty())
+			options.cores = { poolOptions.cores[idx % poolOptions.cores.size()] };
+		if (!poolOptions.name.empty())
+			options.name = poolOptions.name + "-" + std::to_string(idx);
+
+		return options;
+	}
+
+	//Thread of execution owned by one of the consumer classes, like std::thread but honouring ThreadOptions
+	//Everything except the name and the nice value goes into the attributes the thread is created with, so if the
+	//OS refuses any of them(e.g. SCHED_FIFO without CAP_SYS_NICE) the constructor throws std::system_error and no thread is started
+	//A core that doesn't fit in a cpu_set_t makes it throw std::invalid_argument instead
+	//The name and the nice value are applied by the thread itself before it runs 'func', failures to do so are ignored
+	class Thread
+	{
+#if defined(__linux__)
+		struct StartInfo
+		{
+			Task m_func;
+			std::string m_name;
+			bool m_applyNice;
+			int m_nice;
+		};
+
+		pthread_t m_handle;
+		bool m_joinable;
+
+		static void* entry(void* arg)
+		{
+			std::unique_ptr<StartInfo> startInfo(static_cast<StartInfo*>(arg));
+			if (!startInfo->m_name.empty())
+				pthread_setname_np(pthread_self(), startInfo->m_name.substr(0, 15).c_str());
+			if (startInfo->m_applyNice)
+				setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), startInfo->m_nice);
+
+			startInfo->m_func();
+			return nullptr;
+		}
+
+		static void check(int rc, const char* what)
+		{
+			if (rc)
+				throw std::system_error(rc, std::generic_category(), what);
+		}
+
+		void start(const ThreadOptions& options, Task&& func)
+		{
+			pthread_attr_t attr;
+			check(pthread_attr_init(&attr), "pthread_attr_init");
+			std::unique_ptr<pthread_attr_t, int(*)(pthread_attr_t*)> attrGuard(&attr, &pthread_attr_destroy);
+
+			if (options.stackSize)
+				check(pthread_attr_setstacksize(&attr, std::max<size_t>(options.stackSize, PTHREAD_STACK_MIN)), "pthread_attr_setstacksize");
+
+			if (!options.cores.empty())
+			{
+				cpu_set_t cpuSet;
+				CPU_ZERO(&cpuSet);
+				for (int core : options.cores)
+				{
+					if (core < 0 || core >= CPU_SETSIZE)
+						throw std::invalid_argument("A core has to be in [0, CPU_SETSIZE)");
+					CPU_SET(core, &cpuSet);
+				}
+				check(pthread_attr_setaffinity_np(&attr, sizeof(cpuSet), &cpuSet), "pthread_attr_setaffinity_np");
+			}
+
+			if (SchedulingPolicy::Default != options.schedulingPolicy)
+			{
+				sched_param param{};
+				param.sched_priority = options.priority;
+				check(pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED), "pthread_attr_setinheritsched");
+				check(pthread_attr_setschedpolicy(&attr, SchedulingPolicy::Fifo == options.schedulingPolicy ? SCHED_FIFO : SCHED_RR), "pthread_attr_setschedpolicy");
+				check(pthread_attr_setschedparam(&attr, &param), "pthread_attr_setschedparam");
+			}
+
+			auto startInfo = std::make_unique<StartInfo>(StartInfo{ std::move(func),
+				options.name,
+				SchedulingPolicy::Default == options.schedulingPolicy && 0 != options.priority,
+				options.priority });
+			check(pthread_create(&m_handle, &attr, &Thread::entry, startInfo.get()), "pthread_create");
+			startInfo.release();
+			m_joinable = true;
+		}
+
+	public:
+		Thread() : m_handle(), m_joinable(false)
+		{
+		}
+
+		Thread(const ThreadOptions& options, Task&& func) : m_handle(), m_joinable(false)
+		{
+			start(options, std::move(func));
+		}
+
+		Thread(Thread&& other) noexcept : m_handle(other.m_handle), m_joinable(other.m_joinable)
+		{
+			other.m_joinable = false;
+		}
+
+		Thread& operator=(Thread&& other) noexcept
+		{
+			if (m_joinable)
+				std::terminate();//Same as overwriting a joinable std::thread
+
+			m_handle = other.m_handle;
+			m_joinable = other.m_joinable;
+			other.m_joinable = false;
+			return *this;
+		}
+
+		bool joinable() const
+		{
+			return m_joinable;
+		}
+
+		void join()
+		{
+			if (!m_joinable)
+				throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Thread is not joinable");
+
+			check(pthread_join(m_handle, nullptr), "pthread_join");
+			m_joinable = false;
+		}
+
+		~Thread()
+		{
+			if (m_joinable)
+				std::terminate();
+		}
+#else
+		stdThread m_thread;
+
+	public:
+		Thread()
+		{
+		}
+
+		Thread(const ThreadOptions& options, Task&& func) : m_thread([func = std::move(func)]() mutable { func(); })
+		{
+		}
+
+		bool joinable() const
+		{
+			return m_thread.joinable();
+		}
+
+		void join()
+		{
+			m_thread.join();
+		}
+#endif
+	};
+}
@@ -1,33 +1,233 @@
 #pragma once
 #include "WorkerThread.hpp"
+#include "WorkStealingPool.hpp"
+#include "ElasticPool.hpp"
+#include "ParallelAlgorithms.hpp"
 
 namespace ULMTTools
 {
+	enum class PoolMode
+	{
+		RoundRobin,//Each task goes to the next WorkerThread in turn, tasks queued behind a long one wait for it
+		WorkStealing,//Idle workers steal the tasks queued behind busy ones, see WorkStealingPool
+		Elastic//Workers share one queue and are added and retired with the load, see ElasticPool
+	};
+
+	typedef mtInternalUtils::ElasticPoolOptions ElasticPoolOptions;
+
 	class ThreadPool
 	{
-		size_t m_numThreads;
+		PoolMode m_mode;
+		size_t m_numThreads;//The maximum with PoolMode::Elastic
 		std::atomic<size_t> m_currWorkerIdx;
-		WorkerThread* m_workers;
+		std::vector<std::unique_ptr<WorkerThread>> m_workers;//PoolMode::RoundRobin
+		std::unique_ptr<mtInternalUtils::WorkStealingPool> m_stealingPool;//PoolMode::WorkStealing
+		std::unique_ptr<mtInternalUtils::ElasticPool> m_elasticPool;//PoolMode::Elastic
+
+		//Atomic so that concurrent pushes still spread evenly over the workers
+		WorkerThread& nextWorker()
+		{
+			return *m_workers[m_currWorkerIdx.fetch_add(1, std::memory_order_relaxed) % m_numThreads];
+		}
+
+		static std::vector<ThreadOptions> perWorkerOptions(size_t numThreads, const ThreadOptions& threadOptions)
+		{
+			std::vector<ThreadOptions> workerOptions;
+			for (size_t i = 0; i < numThreads; i++)
+				workerOptions.push_back(mtInternalUtils::workerThreadOptions(threadOptions, i));
+
+			return workerOptions;
+		}
 
 	public:
-		ThreadPool(const uint& numThreads) : 
-			m_numThreads(numThreads),
+		//threadOptions.cores is the core map, worker i is pinned to cores[i % cores.size()]
+		//and threadOptions.name, if given, is suffixed with "-i" for worker i, rest of the options apply to every worker as they are
+		ThreadPool(const uint& numThreads, const ThreadOptions& threadOptions = ThreadOptions()) :
+			ThreadPool(perWorkerOptions(numThreads, threadOptions))
+		{
+		}
+
+		ThreadPool(const uint& numThreads, PoolMode mode, const ThreadOptions& threadOptions = ThreadOptions()) :
+			ThreadPool(perWorkerOptions(numThreads, threadOptions), mode)
+		{
+		}
+
+		//One worker per entry, each set up exactly as its entry says
+		explicit ThreadPool(const std::vector<ThreadOptions>& workerOptions, PoolMode mode = PoolMode::RoundRobin) :
+			m_mode(mode),
+			m_numThreads(workerOptions.size()),
+			m_currWorkerIdx(0)
+		{
+			if (PoolMode::WorkStealing == m_mode)
+			{
+				m_stealingPool = std::make_unique<mtInternalUtils::WorkStealingPool>(workerOptions);
+				return;
+			}
+
+			if (PoolMode::Elastic == m_mode)
+				throw std::invalid_argument("An elastic thread pool is constructed from ElasticPoolOptions");
+
+			m_workers.reserve(m_numThreads);
+			for (const ThreadOptions& options : workerOptions)
+				m_workers.push_back(std::make_unique<WorkerThread>(options));
+		}
+
+		//PoolMode::Elastic, between elasticOptions.minThreads and elasticOptions.maxThreads workers depending on the load
+		//Worker i is set up as for the constructors above, i counting every worker started so far
+		explicit ThreadPool(const ElasticPoolOptions& elasticOptions, const ThreadOptions& threadOptions = ThreadOptions()) :
+			m_mode(PoolMode::Elastic),
+			m_numThreads(elasticOptions.maxThreads),
 			m_currWorkerIdx(0),
-			m_workers(new WorkerThread[numThreads])
+			m_elasticPool(std::make_unique<mtInternalUtils::ElasticPool>(elasticOptions, threadOptions))
 		{
 		}
 
+		void push(Task&& task)
+		{
+			if (PoolMode::WorkStealing == m_mode)
+				m_stealingPool->push(std::move(task));
+			else if (PoolMode::Elastic == m_mode)
+				m_elasticPool->push(std::move(task));
+			else
+				nextWorker().push(std::move(task));
+		}
+
+		template <class F>
+		void emplace(F&& func)
+		{
+			if (PoolMode::WorkStealing == m_mode)
+				m_stealingPool->emplace(std::forward<F>(func));
+			else if (PoolMode::Elastic == m_mode)
+				m_elasticPool->emplace(std::forward<F>(func));
+			else
+				nextWorker().emplace(std::forward<F>(func));
+		}
+
+		//Runs 'func' on one of the workers and returns the future of its result
+		template <class F>
+		auto submit(F&& func)
+		{
+			return mtInternalUtils::submit(*this, std::forward<F>(func));
+		}
+
+		//co_await pool.schedule() continues the coroutine on one of the workers
+		mtInternalUtils::ScheduleAwaitable<ThreadPool> schedule()
+		{
+			return mtInternalUtils::ScheduleAwaitable<ThreadPool>(*this);
+		}
+
+		//Calls func(i) for every i in [first, last), or func(begin, end) for sub ranges if it takes 2 arguments,
+		//spread over the workers and the calling thread and returns when all the calls have returned
+		//Chunks adapt to the load, starting large and shrinking towards 'grain'(minimum chunk size, 1 if 0) near the end
+		//The first exception thrown by func calls off the rest of the loop and is rethrown here
+		//Can be called from a task running on the pool itself, the calling worker takes part instead of blocking
+		template <class F>
+		void parallel_for(size_t first, size_t last, F&& func, size_t grain = 0)
+		{
+			auto body = [&func](size_t begin, size_t end)
+			{
+				if constexpr (std::is_invocable_v<F&, size_t, size_t>)
+					func(begin, end);
+				else
+					for (size_t i = begin; i < end; i++)
+						func(i);
+			};
+
+			mtInternalUtils::parallelChunks(*this, m_numThreads, first, last, grain, body);
+		}
+
+		//Returns reduce(...reduce(reduce(identity, transform(first)), transform(first + 1))..., transform(last - 1))
+		//computed in parallel, so 'reduce' has to be associative and commutative and 'identity' its identity element
+		template <class T, class Transform, class Reduce>
+		T parallel_reduce(size_t first, size_t last, T identity, Transform&& transform, Reduce&& reduce, size_t grain = 0)
+		{
+			T result = identity;
+			stdMutex mutex;
+			auto body = [&](size_t begin, size_t end)
+			{
+				T partial = identity;
+				for (size_t i = begin; i < end; i++)
+					partial = reduce(std::move(partial), transform(i));
+
+				stdUniqueLock lock(mutex);
+				result = reduce(std::move(result), std::move(partial));
+			};
+
+			mtInternalUtils::parallelChunks(*this, m_numThreads, first, last, grain, body);
+			return result;
+		}
+
+		//Runs all of 'funcs' in parallel, the calling thread included, and returns when all of them have returned
+		template <class... F>
+		void parallel_invoke(F&&... funcs)
+		{
+			auto funcTuple = std::forward_as_tuple(funcs...);
+			auto body = [&funcTuple](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					mtInternalUtils::invokeAt(funcTuple, i, std::index_sequence_for<F...>());
+			};
+
+			mtInternalUtils::parallelChunks(*this, m_numThreads, 0, sizeof...(F), 1, body);
+		}
+
+		//With PoolMode::Elastic, the no. of workers right now
+		size_t numThreads() const
+		{
+			return PoolMode::Elastic == m_mode ? m_elasticPool->numThreads() : m_numThreads;
+		}
+
+		//Highest no. of workers there has been at the same time, only changes with PoolMode::Elastic
+		size_t peakThreads() const
+		{
+			return PoolMode::Elastic == m_mode ? m_elasticPool->peakThreads() : m_numThreads;
+		}
+
+		//Splits the range into one contiguous chunk per worker and hands over each chunk with a single push_bulk
+		//With PoolMode::WorkStealing the whole range goes to the pool at once and the workers balance it among themselves
+		//The tasks in the range are moved from, needs at least forward iterators
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			if (PoolMode::WorkStealing == m_mode)
+			{
+				m_stealingPool->push_bulk(first, last);
+				return;
+			}
+
+			if (PoolMode::Elastic == m_mode)
+			{
+				m_elasticPool->push_bulk(first, last);
+				return;
+			}
+
+			size_t numTasks = std::distance(first, last);
+			size_t chunkSize = numTasks / m_numThreads;
+			size_t remainder = numTasks % m_numThreads;
+
+			for (size_t i = 0; i < m_numThreads && first != last; i++)
+			{
+				//The first 'remainder' chunks take one extra task each
+				size_t currChunkSize = chunkSize + (i < remainder ? 1 : 0);
+				if (!currChunkSize)
+					break;
+
+				It chunkEnd = std::next(first, currChunkSize);
+				nextWorker().push_bulk(first, chunkEnd);
+				first = chunkEnd;
+			}
+		}
 
-		void push(const Task& task)
+		void push_bulk(std::span<Task> tasks)
 		{
-			m_currWorkerIdx = (m_currWorkerIdx + 1) % m_numThreads;
-			m_workers[m_currWorkerIdx].push(task);
+			push_bulk(tasks.begin(), tasks.end());
 		}
 
 		void kill()
 		{
-			delete[] m_workers;
-			m_workers = nullptr;
+			m_workers.clear();
+			m_stealingPool.reset();
+			m_elasticPool.reset();
 		}
 
 		~ThreadPool()
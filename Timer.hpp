@@ -1,71 +1,187 @@
 #pragma once
 #include "TaskScheduler.hpp"
+#include <array>
+#include <cmath>
 #include <unordered_map>
 
 
 namespace ULMTTools
 {
+	//Where in its interval a timer's first run falls, see TimerOptions
+	enum class TimerPhase
+	{
+		Aligned,//At the installation(plus TimerOptions::initialDelay)
+		Random,//At a random offset in [0, interval)
+		Spread//At an offset in [0, interval) evenly spread over the timers installed so far(golden ratio sequence), so
+			//that timers installed together, e.g. a heartbeat per session at startup, don't fire in the same wakeups
+	};
+
+	struct TimerOptions : PeriodicOptions
+	{
+		duration initialDelay = duration::zero();
+		TimerPhase phase = TimerPhase::Aligned;
+
+		TimerOptions() = default;
+
+		TimerOptions(const PeriodicOptions& periodicOptions) : PeriodicOptions(periodicOptions)
+		{}
+	};
+
+	//Each timer is a periodic task of the TaskScheduler(see TaskScheduler::push_periodic()), rescheduled by the scheduler
+	//thread itself, so a run takes no lock of the Timer and allocates nothing
+	//The Timer only maps its ids to the handles of those tasks, in shards picked by the id, so that installing and
+	//uninstalling timers from many threads doesn't go through one lock
 	class Timer
 	{
-		typedef std::pair<Task, duration> TaskDurationPair;
+		static constexpr size_t numShards = 64;
+
+		struct alignas(64) Shard
+		{
+			stdMutex m_mutex;
+			std::unordered_map<size_t, TimerHandle> m_handlesByTimerID;
+		};
 
 		TaskScheduler_SPtr m_workerThread;
-		std::unordered_map<size_t, TaskDurationPair> m_taskListByTimerID;
-		stdMutex m_mutex;
+		std::array<Shard, numShards> m_shards;
 
 		//Incremented everytime a new timer is installed, a simple solution to generating new unique ids
-		size_t m_incrementalTimerId;
+		std::atomic<size_t> m_incrementalTimerId;
+		//Incremented for every timer installed with TimerPhase::Random or TimerPhase::Spread, the index of its phase
+		std::atomic<uint64_t> m_numPhased;
+		uint64_t m_phaseSeed;//TimerPhase::Random, so that timers of different Timers don't get the same phases
+
+		Shard& shardOf(size_t timerId)
+		{
+			return m_shards[timerId % numShards];
+		}
+
+		duration phaseOffset(TimerPhase phase, const duration& interval)
+		{
+			if (TimerPhase::Aligned == phase)
+				return duration::zero();
+
+			uint64_t index = m_numPhased.fetch_add(1, std::memory_order_relaxed);
+			double fraction;
+			if (TimerPhase::Spread == phase)
+				fraction = std::fmod(static_cast<double>(index) * 0.6180339887498949, 1.0);
+			else
+			{
+				//splitmix64 of the index, so concurrent installs need nothing more than the counter
+				uint64_t z = (m_phaseSeed + index + 1) * 0x9E3779B97F4A7C15ull;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+				z ^= z >> 31;
+				fraction = static_cast<double>(z >> 11) / static_cast<double>(1ull << 53);
+			}
+
+			return duration(static_cast<duration::rep>(fraction * static_cast<double>(interval.count())));
+		}
+
 	public:
 		explicit Timer(const TaskScheduler_SPtr& workerThread) :
-			m_workerThread(workerThread),
-			m_incrementalTimerId(0)
+			m_workerThread(workerThread)
+		{
+			m_incrementalTimerId = 0;
+			m_numPhased = 0;
+			m_phaseSeed = reinterpret_cast<uintptr_t>(this) ^ static_cast<uint64_t>(ULCommonUtils::now().time_since_epoch().count());
+		}
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		//The runs don't refer to the Timer, so the timers still installed are uninstalled here rather than left running
+		//in the scheduler with nothing able to cancel them, with the same caveats as unInstall()
+		~Timer()
+		{
+			for (Shard& shard : m_shards)
+			{
+				std::unordered_map<size_t, TimerHandle> handlesByTimerID;
+				{
+					std::unique_lock<stdMutex> lock(shard.m_mutex);
+					handlesByTimerID.swap(shard.m_handlesByTimerID);
+				}
+
+				for (auto& entry : handlesByTimerID)
+					entry.second.cancel();
+			}
+		}
+
+		//Each run may be upto 'slack' late, for timers such as heartbeats that can share the scheduler's wakeups, see
+		//TaskScheduler::push(), 0 leaving it to the scheduler's SchedulerOptions::slack. The runs stay on the original period whatever the slack
+		size_t install(Task&& task, const duration& interval, const duration& slack = duration::zero())
 		{
+			return install(std::move(task), interval, TaskExecutor(), slack);
 		}
 
-		size_t install(const Task& task, const duration& interval)
+		//Each run is handed to 'executor'(see makeTaskExecutor()), e.g. the WorkerThread of the component owning the timer,
+		//and the next one scheduled right away, so a slow callback doesn't make this or any other timer late
+		//Runs overlap if a run takes longer than 'interval' on an executor with more than one thread
+		size_t install(Task&& task, const duration& interval, TaskExecutor executor, const duration& slack = duration::zero())
 		{
-			size_t timerId = 0;
+			PeriodicOptions options;
+			options.slack = slack;
+			return install(std::move(task), interval, options, std::move(executor));
+		}
 
+		//PeriodicOptions::overrun decides what happens to the ticks missed by a late or long run, see numMissedTicks()
+		//With an executor, here or the scheduler's, only OverrunPolicy::CatchUp is taken, see OverrunPolicy
+		//A PeriodicOptions::slack of 0 leaves it to the scheduler's SchedulerOptions::slack
+		//The first run is at TimerOptions::initialDelay plus the offset of TimerOptions::phase from now
+		size_t install(Task&& task, const duration& interval, TimerOptions options, TaskExecutor executor = TaskExecutor())
+		{
+			if (!options.slack.count())
+				options.slack = m_workerThread->slack();
+
+			if (executor)
 			{
-				std::unique_lock<stdMutex> lock(m_mutex);
-				timerId = m_incrementalTimerId++;
-				m_taskListByTimerID[timerId] = TaskDurationPair(task, interval);
+				if (OverrunPolicy::CatchUp != options.overrun)
+					throw std::invalid_argument("Only OverrunPolicy::CatchUp applies to timers handed to an executor");
+
+				task = Task([executor = std::move(executor), shared = std::make_shared<Task>(std::move(task))]()
+					{
+						executor(Task([shared]() { (*shared)(); }));
+					});
 			}
 
-			auto now = ULCommonUtils::now();
-			m_workerThread->push(now, [this, timerId, now]() {repeatTask(timerId, now); });
+			size_t timerId = m_incrementalTimerId.fetch_add(1, std::memory_order_relaxed);
+			time_point first = ULCommonUtils::now() + options.initialDelay + phaseOffset(options.phase, interval);
+			TimerHandle handle = m_workerThread->push_periodic(first, interval, options, std::move(task));
 
+			Shard& shard = shardOf(timerId);
+			std::unique_lock<stdMutex> lock(shard.m_mutex);
+			shard.m_handlesByTimerID.emplace(timerId, handle);
 			return timerId;
 		}
 
-
-		void unInstall(const size_t& timerId)
+		//Ticks of the timer that didn't run in their own period so far, see OverrunPolicy, 0 for an unknown timer
+		uint64_t numMissedTicks(const size_t& timerId)
 		{
-			std::unique_lock<stdMutex> lock(m_mutex);
-			m_taskListByTimerID.erase(timerId);
+			Shard& shard = shardOf(timerId);
+			std::unique_lock<stdMutex> lock(shard.m_mutex);
+			auto it = shard.m_handlesByTimerID.find(timerId);
+			return it == shard.m_handlesByTimerID.end() ? 0 : it->second.numMissedTicks();
 		}
 
-	private:
-		void repeatTask(const size_t& timerId, const time_point& scheduledTime)
+		//No run is handed out after this returns, but one in progress completes and, with a TaskExecutor, the runs already
+		//pushed to the executor still start whenever the executor gets to them
+		//Caution! the callback may still be running on the scheduler's thread(or the executor) or be about to run on the
+		//executor when this returns, so an object whose member function it calls must not be deleted right after uninstalling
+		//the timer
+		void unInstall(const size_t& timerId)
 		{
-			std::unique_lock<stdMutex> lock(m_mutex);
-			auto it = m_taskListByTimerID.find(timerId);
-			if (it != m_taskListByTimerID.end())
+			TimerHandle handle;
 			{
-				TaskDurationPair taskSchedulingInfo = it->second;
-
-				//Caution! a possible race condition is that just after unlock, the
-				//client code uninstalls the timer and the predicate is a member function
-				//if just after the uninstall, the object is deleted before the function completes execution, it can lead to a crash
-				//Alternate way to handle it would be to execute the predicate inside lock but then it 
-				//can will block the install function and the execution of other installed timers until
-				//the predicate finishes execution, this is more serious considering this is an api for scheduling tasks
-				//and this can make other timers miss their schedule
-				lock.unlock();
-				taskSchedulingInfo.first();
-				auto newScheduledTime = scheduledTime + taskSchedulingInfo.second;
-				m_workerThread->push(newScheduledTime, [this, timerId, newScheduledTime]() {repeatTask(timerId, newScheduledTime); });
+				Shard& shard = shardOf(timerId);
+				std::unique_lock<stdMutex> lock(shard.m_mutex);
+				auto it = shard.m_handlesByTimerID.find(timerId);
+				if (it == shard.m_handlesByTimerID.end())
+					return;
+
+				handle = it->second;
+				shard.m_handlesByTimerID.erase(it);
 			}
+
+			handle.cancel();
 		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <CommonUtils/CommonDefs.hpp>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace mtInternalUtils
+{
+#if defined(__linux__)
+	//Wakeup of a Scheduler built on a timerfd armed at an absolute CLOCK_MONOTONIC time and an eventfd for pushes and
+	//cancellations, both behind one epoll fd. That fd becomes readable whenever the scheduler has something to do, so it
+	//can be added to an application's own epoll loop in place of a thread of the scheduler's own
+	//Unlike a futex or condition variable wait, which the kernel may delay by the thread's timer slack(50us by default),
+	//the timerfd expires on time
+	class TimerFd
+	{
+		int m_epollFd;
+		int m_timerFd;
+		int m_eventFd;
+		std::atomic<bool> m_notified;//Set from the write to m_eventFd till clear(), so that notify() writes at most once per wakeup
+
+		static void check(int rc, const char* what)
+		{
+			if (-1 == rc)
+				throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		void close()
+		{
+			for (int fd : { m_eventFd, m_timerFd, m_epollFd })
+				if (-1 != fd)
+					::close(fd);
+		}
+
+		void setTime(const itimerspec& spec)
+		{
+			check(timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr), "timerfd_settime failed");
+		}
+
+	public:
+		//Throws std::system_error if any of the fds can't be created
+		TimerFd() : m_epollFd(-1), m_timerFd(-1), m_eventFd(-1)
+		{
+			m_notified = false;
+			try
+			{
+				check(m_epollFd = epoll_create1(EPOLL_CLOEXEC), "epoll_create1 failed");
+				check(m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "timerfd_create failed");
+				check(m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd failed");
+				for (int fd : { m_timerFd, m_eventFd })
+				{
+					epoll_event event{};
+					event.events = EPOLLIN;
+					event.data.fd = fd;
+					check(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event), "epoll_ctl failed");
+				}
+			}
+			catch (...)
+			{
+				close();
+				throw;
+			}
+		}
+
+		TimerFd(const TimerFd&) = delete;
+		TimerFd& operator=(const TimerFd&) = delete;
+
+		//Readable(EPOLLIN) when the armed time has come or notify() has been called since the last clear()
+		int fd() const
+		{
+			return m_epollFd;
+		}
+
+		//'t' is translated to CLOCK_MONOTONIC, a time already past makes the fd readable right away
+		void arm(const time_point& t)
+		{
+			auto fromNow = std::chrono::duration_cast<std::chrono::nanoseconds>(t - ULCommonUtils::now());
+			auto monotonic = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()) + fromNow;
+			//0 would disarm the timer
+			int64_t nanos = std::max<int64_t>(monotonic.count(), 1);
+			itimerspec spec{};
+			spec.it_value.tv_sec = static_cast<time_t>(nanos / 1000000000);
+			spec.it_value.tv_nsec = static_cast<long>(nanos % 1000000000);
+			setTime(spec);
+		}
+
+		void disarm()
+		{
+			setTime(itimerspec{});
+		}
+
+		void notify()
+		{
+			if (m_notified.exchange(true))
+				return;
+
+			uint64_t one = 1;
+			while (-1 == ::write(m_eventFd, &one, sizeof(one)) && EINTR == errno)
+				;
+		}
+
+		void notify_one()
+		{
+			notify();
+		}
+
+		//Consumes the expiry and the notifications so far, anything that is to be seen has to be looked at after this
+		void clear()
+		{
+			uint64_t count = 0;
+			while (-1 == ::read(m_timerFd, &count, sizeof(count)) && EINTR == errno)
+				;
+			while (-1 == ::read(m_eventFd, &count, sizeof(count)) && EINTR == errno)
+				;
+			//Only after draining, a notify() from here on writes again and one seeing the flag still set has already done
+			//what is to be seen after this
+			m_notified = false;
+		}
+
+		//Blocks till fd() is readable
+		void wait()
+		{
+			epoll_event events[2];
+			while (-1 == epoll_wait(m_epollFd, events, 2, -1) && EINTR == errno)
+				;
+		}
+
+		~TimerFd()
+		{
+			close();
+		}
+	};
+#else
+	//No timerfd outside Linux
+	class TimerFd
+	{
+	public:
+		TimerFd()
+		{
+			throw std::runtime_error("SchedulerWakeup::TimerFd is only available on Linux");
+		}
+
+		int fd() const { return -1; }
+		void arm(const time_point&) {}
+		void disarm() {}
+		void notify() {}
+		void notify_one() {}
+		void clear() {}
+		void wait() {}
+	};
+#endif
+}
@@ -0,0 +1,639 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <CommonUtils/CommonDefs.hpp>
+
+namespace mtInternalUtils
+{
+	//Storage used by Scheduler for the items waiting for their time
+	enum class TimerBackend
+	{
+		OrderedMap,//std::map keyed on the time, exact but O(log n) and a node allocation per distinct time
+		TimingWheel//Hierarchical timing wheel, O(1) insert and expiry, times rounded up to SchedulerOptions::tickResolution
+	};
+
+	//How the scheduler thread sleeps till the next item is due
+	enum class SchedulerWakeup
+	{
+		Futex,//Event, portable(a condition variable outside Linux) but the kernel may add the thread's timer slack to the sleep
+		TimerFd//Linux only, timerfd + eventfd behind an epoll fd, precise and pollable, see TimerFd
+	};
+
+	struct SchedulerOptions
+	{
+		TimerBackend backend = TimerBackend::OrderedMap;
+		SchedulerWakeup wakeup = SchedulerWakeup::Futex;
+		//No thread of the scheduler's own, the application polls Scheduler::fd() in its own epoll loop and calls
+		//Scheduler::poll() whenever it is readable, the items being processed on that thread. Needs SchedulerWakeup::TimerFd
+		bool externalLoop = false;
+		//TimerBackend::TimingWheel only, items fire upto one tick late(never early) and those due in the same tick
+		//fire in no particular order
+		duration tickResolution = std::chrono::milliseconds(1);
+		//How late an item pushed without a slack of its own may fire, see applySlack()
+		duration slack = duration::zero();
+	};
+
+	//What a periodic item does when a run starts late or lasts longer than the period
+	enum class OverrunPolicy
+	{
+		CatchUp,//Fixed rate, every tick runs, the late ones back to back
+		Skip,//Fixed rate, the ticks already past when a run ends are dropped, the next run staying on the original phase
+		FixedDelay//The next run is a period after the end of the previous one
+	};
+	//With an executor(TaskScheduler's or Timer::install()'s) a run is only the hand-off of the task, its end and length
+	//unknown to the scheduler, so only CatchUp applies there and the others are refused with std::invalid_argument
+
+	struct PeriodicOptions
+	{
+		OverrunPolicy overrun = OverrunPolicy::CatchUp;
+		//Each run may be upto this late, see applySlack()
+		duration slack = duration::zero();
+		//Each run after the first is delayed by a random time in [0, jitter), on top of the slack, so items of the same
+		//period don't stay in step. The runs keep the original phase, the jitter doesn't accumulate
+		duration jitter = duration::zero();
+	};
+
+	//Counters of a Scheduler's thread, the ratio of numFired to numFiringWakeups showing how well the slack coalesces items
+	struct SchedulerStats
+	{
+		uint64_t numWakeups = 0;//Times the scheduler thread went through its loop, for a push or cancel as well as for a due item
+		uint64_t numFiringWakeups = 0;//Wakeups that fired at least one item
+		uint64_t numFired = 0;
+		uint64_t maxFiredPerWakeup = 0;//The peak of the scheduler thread's work
+	};
+
+	//Picks the time in [t, t + slack] with the most trailing zero bits(as Linux did for timers with a slack), so items
+	//with overlapping windows tend to get the same time and fire in one wakeup whatever their own slack
+	inline time_point applySlack(const time_point& t, const duration& slack)
+	{
+		auto earliest = t.time_since_epoch().count();
+		if (slack <= duration::zero() || earliest < 0)
+			return t;
+
+		uint64_t latest = static_cast<uint64_t>(earliest) + static_cast<uint64_t>(slack.count());
+		uint64_t differing = static_cast<uint64_t>(earliest) ^ latest;
+		uint64_t lowBits = (1ull << (63 - std::countl_zero(differing))) - 1;
+		return time_point(duration(static_cast<duration::rep>(latest & ~lowBits)));
+	}
+
+	//Part of a scheduled item that a TimerHandle looks at, the rest belongs to the scheduler thread
+	//m_stamp packs a generation, bumped every time the entry is reused, with the state of the entry, so that a handle
+	//to an earlier use of the entry can never cancel a later one
+	//A periodic entry goes Pending -> Fired while it runs and back to Pending after, and can be cancelled in either state
+	struct TimerEntry
+	{
+		enum State : uint64_t
+		{
+			Free,
+			Pending,
+			Fired,
+			Cancelled
+		};
+
+		static constexpr unsigned stateBits = 2;
+		static constexpr uint64_t stateMask = (1ull << stateBits) - 1;
+
+		std::atomic<uint64_t> m_stamp;
+		std::atomic<bool> m_periodic;//Set before the entry is handed out, atomic only for stale handles looking at it
+		//Periodic entries, ticks that didn't run in their own period: caught up(OverrunPolicy::CatchUp), dropped(Skip)
+		//or lost to a late start(FixedDelay). Written by the scheduler thread only
+		std::atomic<uint64_t> m_numMissedTicks;
+
+		TimerEntry()
+		{
+			m_stamp = Free;
+			m_periodic = false;
+			m_numMissedTicks = 0;
+		}
+
+		static uint64_t stamp(uint64_t generation, State state)
+		{
+			return (generation << stateBits) | state;
+		}
+
+		uint64_t generation() const
+		{
+			return m_stamp.load() >> stateBits;
+		}
+
+		//Pending -> 'to' for the given generation, fails if the entry has fired, been cancelled or reused meanwhile
+		bool leavePending(uint64_t generation, State to)
+		{
+			uint64_t expected = stamp(generation, Pending);
+			return m_stamp.compare_exchange_strong(expected, stamp(generation, to));
+		}
+
+		//Fired -> Pending after a periodic entry has run, fails if it has been cancelled meanwhile
+		bool rearm(uint64_t generation)
+		{
+			uint64_t expected = stamp(generation, Fired);
+			return m_stamp.compare_exchange_strong(expected, stamp(generation, Pending));
+		}
+
+		bool tryCancel(uint64_t generation)
+		{
+			if (leavePending(generation, Cancelled))
+				return true;
+
+			uint64_t expected = stamp(generation, Fired);
+			return m_periodic.load(std::memory_order_relaxed) && m_stamp.compare_exchange_strong(expected, stamp(generation, Cancelled));
+		}
+	};
+
+	class TimerCanceller
+	{
+	public:
+		virtual bool cancel(TimerEntry* entry, uint64_t generation) = 0;
+
+	protected:
+		~TimerCanceller()
+		{
+		}
+	};
+
+	//Refers to one item pushed to a scheduler, copyable, must not be used after the scheduler is destroyed
+	class TimerHandle
+	{
+		TimerCanceller* m_canceller;
+		TimerEntry* m_entry;
+		uint64_t m_generation;
+
+	public:
+		TimerHandle() : m_canceller(nullptr), m_entry(nullptr), m_generation(0)
+		{
+		}
+
+		TimerHandle(TimerCanceller* canceller, TimerEntry* entry, uint64_t generation) :
+			m_canceller(canceller),
+			m_entry(entry),
+			m_generation(generation)
+		{
+		}
+
+		//O(1), returns true if the item won't run, false if it has run, is running or was cancelled already
+		//A periodic item can be cancelled while it runs, that run completing but no other starting
+		//The item is destroyed and its entry freed by the scheduler thread at its next wakeup, or for TimerBackend::OrderedMap
+		//the item is destroyed then but the entry stays in the map till its time, see Scheduler::numCancelledResident()
+		bool cancel()
+		{
+			return m_entry && m_canceller->cancel(m_entry, m_generation);
+		}
+
+		//See TimerEntry::m_numMissedTicks, 0 once the item has been freed
+		uint64_t numMissedTicks() const
+		{
+			if (!m_entry)
+				return 0;
+
+			//The count is reset only after the generation has moved on, so it belongs to this item if the generation hasn't
+			uint64_t numMissed = m_entry->m_numMissedTicks.load();
+			return m_entry->generation() == m_generation ? numMissed : 0;
+		}
+
+		//false for a default constructed handle
+		bool valid() const
+		{
+			return nullptr != m_entry;
+		}
+	};
+
+	//A scheduled item along with what the timer queues need to keep it
+	template <class T>
+	struct TimerNode : TimerEntry
+	{
+		static constexpr uint8_t inOverflow = 0xFE;
+		static constexpr uint8_t inReady = 0xFF;
+
+		std::optional<T> m_item;
+		time_point m_time;//Due time with the slack applied
+		//Periodic items, rescheduled at m_nominal + m_period with m_slack applied afresh, so the slack doesn't accumulate
+		time_point m_nominal;
+		duration m_period = duration::zero();
+		duration m_slack = duration::zero();
+		OverrunPolicy m_overrun = OverrunPolicy::CatchUp;
+		duration m_jitter = duration::zero();
+		//Scheduler thread only
+		uint64_t m_tick = 0;//TimingWheel
+		TimerNode* m_prev = nullptr;
+		TimerNode* m_next = nullptr;
+		uint8_t m_level = 0;//TimingWheel, inOverflow or inReady for the lists outside the levels
+		uint8_t m_slot = 0;
+		bool m_detached = false;//Taken out of the queue after being cancelled, waiting for the cancellation to be processed
+		bool m_cancelSeen = false;//Cancellation processed while the node stays in the queue
+	};
+
+	//Chunks of nodes recycled through a free list, a node's address never changes and the memory is only given back
+	//on destruction, so a stale TimerHandle can always look at its entry's stamp. Not thread safe
+	template <class T>
+	class TimerNodePool
+	{
+		static constexpr size_t nodesPerChunk = 1024;
+
+		std::vector<std::unique_ptr<TimerNode<T>[]>> m_chunks;
+		TimerNode<T>* m_free;//Singly linked through m_next
+
+	public:
+		TimerNodePool() : m_free(nullptr)
+		{
+		}
+
+		TimerNodePool(const TimerNodePool&) = delete;
+		TimerNodePool& operator=(const TimerNodePool&) = delete;
+
+		TimerNode<T>* allocate()
+		{
+			if (!m_free)
+			{
+				m_chunks.push_back(std::make_unique<TimerNode<T>[]>(nodesPerChunk));
+				TimerNode<T>* chunk = m_chunks.back().get();
+				for (size_t i = 0; i < nodesPerChunk; i++)
+				{
+					chunk[i].m_next = m_free;
+					m_free = &chunk[i];
+				}
+			}
+
+			TimerNode<T>* node = m_free;
+			m_free = node->m_next;
+			return node;
+		}
+
+		//The node's item must have been destroyed already
+		void release(TimerNode<T>* node)
+		{
+			node->m_next = m_free;
+			m_free = node;
+		}
+	};
+
+	//Hierarchical timing wheel(Varghese & Lauck, "Hashed and Hierarchical Timing Wheels"), not thread safe
+	//Time is counted in ticks since construction, each level has 64 slots and a slot of level l spans 64^l ticks
+	//An item goes to the level of the highest base 64 digit in which its tick differs from the current tick, so level 0
+	//holds the items due within the current 64 ticks and the items of a higher level slot move down(cascade) when the
+	//current tick enters that slot. Insert, removal and expiry are O(1), each item cascading at most once per level
+	//Idle stretches are skipped slot by slot using a bitmap of the occupied slots per level, not tick by tick
+	template <class T>
+	class TimingWheel
+	{
+		typedef TimerNode<T> Node;
+
+		static constexpr unsigned bitsPerLevel = 6;
+		static constexpr uint64_t slotsPerLevel = 1ull << bitsPerLevel;
+		static constexpr uint64_t slotMask = slotsPerLevel - 1;
+		static constexpr unsigned numLevels = 6;//64^6 ticks, i.e. 2 years at 1ms or 19 hours at 1us, the rest waits in m_overflow
+
+		const duration m_tickDuration;
+		const time_point m_origin;
+		uint64_t m_currTick;//Every tick upto and including this one has been processed
+		//Lists are circular and doubly linked, the head's m_prev being the tail
+		Node* m_slots[numLevels][slotsPerLevel];
+		uint64_t m_occupied[numLevels];//Bit i is set if slot i of the level is non empty
+		Node* m_overflow;//Items beyond the reach of the top level
+		uint64_t m_overflowMinTick;
+		Node* m_ready;//Items already due when inserted or cascaded
+		size_t m_size;
+
+		static void append(Node*& head, Node* node)
+		{
+			if (!head)
+			{
+				node->m_prev = node->m_next = node;
+				head = node;
+				return;
+			}
+
+			Node* tail = head->m_prev;
+			tail->m_next = node;
+			node->m_prev = tail;
+			node->m_next = head;
+			head->m_prev = node;
+		}
+
+		static void unlink(Node*& head, Node* node)
+		{
+			if (node->m_next == node)
+				head = nullptr;
+			else
+			{
+				node->m_prev->m_next = node->m_next;
+				node->m_next->m_prev = node->m_prev;
+				if (head == node)
+					head = node->m_next;
+			}
+		}
+
+		//Detaches the whole list and returns it null terminated, for iterating while the nodes get relinked or freed
+		static Node* take(Node*& head)
+		{
+			Node* list = head;
+			head = nullptr;
+			if (list)
+				list->m_prev->m_next = nullptr;
+			return list;
+		}
+
+		uint64_t tickAtOrAfter(const time_point& t) const
+		{
+			if (t <= m_origin)
+				return 0;
+
+			return static_cast<uint64_t>(((t - m_origin).count() + m_tickDuration.count() - 1) / m_tickDuration.count());
+		}
+
+		uint64_t tickAtOrBefore(const time_point& t) const
+		{
+			if (t <= m_origin)
+				return 0;
+
+			return static_cast<uint64_t>((t - m_origin).count() / m_tickDuration.count());
+		}
+
+		time_point timeOf(uint64_t tick) const
+		{
+			return m_origin + m_tickDuration * static_cast<int64_t>(tick);
+		}
+
+		void place(Node* node)
+		{
+			if (node->m_tick <= m_currTick)
+			{
+				node->m_level = Node::inReady;
+				append(m_ready, node);
+				return;
+			}
+
+			unsigned level = (63 - std::countl_zero(node->m_tick ^ m_currTick)) / bitsPerLevel;
+			if (level >= numLevels)
+			{
+				node->m_level = Node::inOverflow;
+				append(m_overflow, node);
+				m_overflowMinTick = std::min(m_overflowMinTick, node->m_tick);
+				return;
+			}
+
+			uint64_t slot = (node->m_tick >> (level * bitsPerLevel)) & slotMask;
+			node->m_level = static_cast<uint8_t>(level);
+			node->m_slot = static_cast<uint8_t>(slot);
+			append(m_slots[level][slot], node);
+			m_occupied[level] |= 1ull << slot;
+		}
+
+		void replace(Node* list)
+		{
+			while (list)
+			{
+				Node* next = list->m_next;
+				place(list);
+				list = next;
+			}
+		}
+
+		//Smallest tick after m_currTick at which a slot fires or cascades, false if there is none
+		//Every item of level l is ahead of the current tick in digit l and equal to it in the digits above, so only
+		//the slots after the current one in each level need to be looked at, and a lower level always comes first
+		bool nextTick(uint64_t& tick) const
+		{
+			for (unsigned level = 0; level < numLevels; level++)
+			{
+				unsigned shift = level * bitsPerLevel;
+				uint64_t digit = (m_currTick >> shift) & slotMask;
+				uint64_t ahead = slotMask == digit ? 0 : m_occupied[level] & (~0ull << (digit + 1));
+				if (ahead)
+				{
+					uint64_t blockStart = (m_currTick >> (shift + bitsPerLevel)) << (shift + bitsPerLevel);
+					tick = blockStart | (static_cast<uint64_t>(std::countr_zero(ahead)) << shift);
+					return true;
+				}
+			}
+
+			if (m_overflow)
+			{
+				tick = (m_overflowMinTick >> (numLevels * bitsPerLevel)) << (numLevels * bitsPerLevel);
+				return true;
+			}
+
+			return false;
+		}
+
+		//m_currTick has just entered a new slot of every level whose lower digits are all 0, higher levels go first
+		//as their items may land in the lower levels' slots being entered
+		void cascade()
+		{
+			if (m_overflow && !(m_currTick & ((1ull << (numLevels * bitsPerLevel)) - 1)))
+			{
+				m_overflowMinTick = std::numeric_limits<uint64_t>::max();
+				replace(take(m_overflow));
+			}
+
+			for (unsigned level = numLevels - 1; level > 0; level--)
+			{
+				unsigned shift = level * bitsPerLevel;
+				if (m_currTick & ((1ull << shift) - 1))
+					continue;
+
+				uint64_t slot = (m_currTick >> shift) & slotMask;
+				if (m_occupied[level] & (1ull << slot))
+				{
+					m_occupied[level] &= ~(1ull << slot);
+					replace(take(m_slots[level][slot]));
+				}
+			}
+		}
+
+		template <class F>
+		void fire(Node*& head, F& func)
+		{
+			Node* list = take(head);
+			while (list)
+			{
+				Node* next = list->m_next;
+				m_size--;
+				func(list);
+				list = next;
+			}
+		}
+
+	public:
+		explicit TimingWheel(const duration& tickDuration, const time_point& origin = ULCommonUtils::now()) :
+			m_tickDuration(tickDuration),
+			m_origin(origin),
+			m_currTick(0),
+			m_slots(),
+			m_occupied(),
+			m_overflow(nullptr),
+			m_overflowMinTick(std::numeric_limits<uint64_t>::max()),
+			m_ready(nullptr),
+			m_size(0)
+		{
+			if (m_tickDuration.count() <= 0)
+				throw std::invalid_argument("The tick of a timing wheel has to be positive");
+		}
+
+		TimingWheel(const TimingWheel&) = delete;
+		TimingWheel& operator=(const TimingWheel&) = delete;
+
+		//Due at node->m_time
+		void insert(Node* node)
+		{
+			node->m_tick = tickAtOrAfter(node->m_time);
+			place(node);
+			m_size++;
+		}
+
+		void remove(Node* node)
+		{
+			if (Node::inReady == node->m_level)
+				unlink(m_ready, node);
+			else if (Node::inOverflow == node->m_level)
+				unlink(m_overflow, node);//m_overflowMinTick may now be too low, costing at most an early cascade
+			else
+			{
+				Node*& head = m_slots[node->m_level][node->m_slot];
+				unlink(head, node);
+				if (!head)
+					m_occupied[node->m_level] &= ~(1ull << node->m_slot);
+			}
+
+			m_size--;
+		}
+
+		//Takes out every node due at 'now' and calls func(node) for it, the node is no longer in the wheel by then and may
+		//be inserted again, firing in this same call if it is due again
+		template <class F>
+		void expire(const time_point& now, F&& func)
+		{
+			uint64_t target = tickAtOrBefore(now);
+			fire(m_ready, func);
+
+			uint64_t tick = 0;
+			while (nextTick(tick) && tick <= target)
+			{
+				m_currTick = tick;
+				cascade();
+				uint64_t slot = tick & slotMask;
+				if (m_occupied[0] & (1ull << slot))
+				{
+					m_occupied[0] &= ~(1ull << slot);
+					fire(m_slots[0][slot], func);
+				}
+				fire(m_ready, func);
+			}
+
+			//Nothing fires or cascades upto 'target', so every item stays where it is relative to it
+			m_currTick = std::max(m_currTick, target);
+		}
+
+		//The time at which expire() has something to do next, which may be a cascade rather than an item being due
+		bool nextExpiry(time_point& t) const
+		{
+			if (m_ready)
+			{
+				t = timeOf(m_currTick);
+				return true;
+			}
+
+			uint64_t tick = 0;
+			if (!nextTick(tick))
+				return false;
+
+			t = timeOf(tick);
+			return true;
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+	};
+
+	//Nodes of a Scheduler waiting for their time, kept as per SchedulerOptions::backend, not thread safe
+	//The nodes belong to the caller, the queue only links them
+	template <class T>
+	class TimerQueue
+	{
+		typedef TimerNode<T> Node;
+
+		const SchedulerOptions m_options;
+		std::map<time_point, std::vector<Node*>> m_map;//TimerBackend::OrderedMap
+		size_t m_mapSize;
+		std::unique_ptr<TimingWheel<T>> m_wheel;//TimerBackend::TimingWheel
+
+	public:
+		explicit TimerQueue(const SchedulerOptions& options) : m_options(options), m_mapSize(0)
+		{
+			if (TimerBackend::TimingWheel == m_options.backend)
+				m_wheel = std::make_unique<TimingWheel<T>>(m_options.tickResolution);
+		}
+
+		//Due at node->m_time
+		void insert(Node* node)
+		{
+			if (m_wheel)
+				m_wheel->insert(node);
+			else
+			{
+				m_map[node->m_time].push_back(node);
+				m_mapSize++;
+			}
+		}
+
+		//O(1) with the wheel, returns false for the map where finding the node would cost a search, the node then stays
+		//till its time and comes out of expire() like the others
+		bool remove(Node* node)
+		{
+			if (!m_wheel)
+				return false;
+
+			m_wheel->remove(node);
+			return true;
+		}
+
+		//Takes out every node due at 'now' and calls func(node) for it, in the order of their times upto the backend's resolution
+		template <class F>
+		void expire(const time_point& now, F&& func)
+		{
+			if (m_wheel)
+			{
+				m_wheel->expire(now, func);
+				return;
+			}
+
+			while (!m_map.empty() && m_map.begin()->first <= now)
+			{
+				//Taken out first, as func may insert the node again
+				auto it = m_map.begin();
+				std::vector<Node*> nodes = std::move(it->second);
+				m_mapSize -= nodes.size();
+				m_map.erase(it);
+				for (Node* node : nodes)
+					func(node);
+			}
+		}
+
+		//false if there is nothing pending
+		bool nextExpiry(time_point& t) const
+		{
+			if (m_wheel)
+				return m_wheel->nextExpiry(t);
+
+			if (m_map.empty())
+				return false;
+
+			t = m_map.begin()->first;
+			return true;
+		}
+
+		size_t size() const
+		{
+			return m_wheel ? m_wheel->size() : m_mapSize;
+		}
+	};
+}
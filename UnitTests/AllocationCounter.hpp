@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+//Replaces the global allocation functions to count the allocations made by each thread, for the tests checking
+//that something doesn't allocate, include it from a single source file of the test executable
+//Every form of operator new/delete is replaced, all of them on top of malloc/free, so whichever pair the compiler
+//picks for an expression(sized, aligned, array, nothrow) the memory goes back where it came from
+namespace AllocationCounter
+{
+	inline thread_local size_t numAllocations = 0;
+
+	inline void* allocate(size_t size, size_t alignment)
+	{
+		++numAllocations;
+		if (0 == size)
+			size = 1;
+		if (alignment <= alignof(std::max_align_t))
+			return std::malloc(size);
+
+		//aligned_alloc wants a size which is a multiple of the alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+	}
+
+	inline void* allocateOrThrow(size_t size, size_t alignment)
+	{
+		if (void* ptr = allocate(size, alignment))
+			return ptr;
+		throw std::bad_alloc();
+	}
+}
+
+void* operator new(size_t size)
+{
+	return AllocationCounter::allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size)
+{
+	return AllocationCounter::allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return AllocationCounter::allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return AllocationCounter::allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocationCounter::allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocationCounter::allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocationCounter::allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocationCounter::allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
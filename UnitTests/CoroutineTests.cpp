@@ -0,0 +1,154 @@
+#include <ThreadPool.hpp>
+#include <TaskThrottlers.hpp>
+#include <gtest/gtest.h>
+#include "AllocationCounter.hpp"
+#include <thread>
+
+namespace mt = ULMTTools;
+
+namespace
+{
+	mt::CoTask<std::thread::id> currentThread()
+	{
+		co_return std::this_thread::get_id();
+	}
+
+	mt::CoTask<int> add(int a, int b)
+	{
+		co_return a + b;
+	}
+
+	mt::CoTask<int> fail()
+	{
+		throw std::logic_error("failed");
+		co_return 0;
+	}
+}
+
+TEST(CoroutineTests, ScheduleHopsBetweenWorkers)
+{
+	mt::WorkerThread worker1;
+	mt::WorkerThread worker2;
+	auto worker1Id = worker1.submit([]() { return std::this_thread::get_id(); }).get();
+	auto worker2Id = worker2.submit([]() { return std::this_thread::get_id(); }).get();
+
+	auto hops = [&]() -> mt::CoTask<std::vector<std::thread::id>>
+	{
+		std::vector<std::thread::id> ids;
+		co_await worker1.schedule();
+		ids.push_back(co_await currentThread());
+		co_await worker2.schedule();
+		ids.push_back(std::this_thread::get_id());
+		co_await worker1.schedule();
+		ids.push_back(std::this_thread::get_id());
+		co_return ids;
+	};
+
+	auto ids = mt::spawn(hops()).get();
+	ASSERT_EQ((std::vector<std::thread::id>{ worker1Id, worker2Id, worker1Id }), ids);
+}
+
+TEST(CoroutineTests, NestedTasksPassValuesAndExceptions)
+{
+	mt::ThreadPool pool(2, mt::PoolMode::WorkStealing);
+	auto outer = [&]() -> mt::CoTask<int>
+	{
+		co_await pool.schedule();
+		int sum = co_await add(1, 2);
+		sum += co_await add(sum, 10);
+		try
+		{
+			co_await fail();
+		}
+		catch (const std::logic_error&)
+		{
+			sum *= 2;
+		}
+
+		co_return sum;
+	};
+
+	ASSERT_EQ(32, mt::spawn(outer()).get());
+	ASSERT_THROW(mt::spawn(fail()).get(), std::logic_error);
+}
+
+TEST(CoroutineTests, SleepUntil)
+{
+	mt::TaskScheduler scheduler;
+	auto sleepFor = std::chrono::milliseconds(50);
+
+	auto sleeper = [&]() -> mt::CoTask<duration>
+	{
+		auto start = ULCommonUtils::now();
+		co_await scheduler.sleep_until(start + sleepFor);
+		co_await scheduler.sleep_for(sleepFor);
+		co_return ULCommonUtils::now() - start;
+	};
+
+	ASSERT_GE(mt::spawn(sleeper()).get(), 2 * sleepFor);
+
+	//A time in the past doesn't suspend at all
+	auto pastSleeper = [&]() -> mt::CoTask<std::thread::id>
+	{
+		co_await scheduler.sleep_until(ULCommonUtils::now() - sleepFor);
+		co_return std::this_thread::get_id();
+	};
+	ASSERT_EQ(std::this_thread::get_id(), mt::spawn(pastSleeper()).get());
+}
+
+TEST(CoroutineTests, ThrottlerAcquireRespectsBandwidth)
+{
+	auto unitTime = std::chrono::milliseconds(100);
+	const size_t numTransactions = 5;
+	mt::ThrottledWorkerThread throttler(unitTime, numTransactions);
+
+	auto acquirer = [&]() -> mt::CoTask<duration>
+	{
+		auto start = ULCommonUtils::now();
+		for (size_t i = 0; i < 3 * numTransactions; i++)
+			co_await throttler.acquire();
+		co_return ULCommonUtils::now() - start;
+	};
+
+	//The first batch goes right away, the other 2 have to wait for a unit of time each
+	ASSERT_GE(mt::spawn(acquirer()).get(), 2 * unitTime);
+	throttler.kill();
+}
+
+TEST(CoroutineTests, LongChainsOfAwaitsDontGrowTheStack)
+{
+	auto chain = []() -> mt::CoTask<long>
+	{
+		long sum = 0;
+		for (int i = 0; i < 1000000; i++)
+			sum += co_await add(i, 0);
+		co_return sum;
+	};
+
+	ASSERT_EQ(499999500000L, mt::spawn(chain()).get());
+}
+
+TEST(CoroutineTests, FramesAreRecycled)
+{
+	auto outer = []() -> mt::CoTask<int>
+	{
+		int sum = 0;
+		for (int i = 0; i < 10; i++)
+			sum += co_await add(i, 1);
+		co_return sum;
+	};
+
+	//Warm up the frame pool and the future's state pool
+	ASSERT_EQ(55, mt::spawn(outer()).get());
+
+	size_t allocationsBefore = AllocationCounter::numAllocations;
+	for (int i = 0; i < 1000; i++)
+		mt::spawn(outer()).get();
+	ASSERT_EQ(allocationsBefore, AllocationCounter::numAllocations);
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+#include <Event.hpp>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace mtInternal = mtInternalUtils;
+
+struct EventTests : ::testing::Test
+{
+	std::chrono::milliseconds timeout;
+
+	virtual void SetUp()
+	{
+		timeout = std::chrono::milliseconds(50);
+	}
+};
+
+TEST_F(EventTests, NotifyBeforeWaitIsRemembered)
+{
+	mtInternal::Event event;
+	event.notify();
+	//Should return right away, and consume the notification
+	event.wait();
+
+	auto start = std::chrono::steady_clock::now();
+	event.wait_for(timeout);
+	ASSERT_GE(std::chrono::steady_clock::now() - start, timeout);
+}
+
+TEST_F(EventTests, WaitUntilTimesOutOnBothClocks)
+{
+	mtInternal::Event event;
+
+	auto steadyDeadline = std::chrono::steady_clock::now() + timeout;
+	event.wait_until(steadyDeadline);
+	ASSERT_GE(std::chrono::steady_clock::now(), steadyDeadline);
+
+	auto systemDeadline = std::chrono::system_clock::now() + timeout;
+	event.wait_until(systemDeadline);
+	ASSERT_GE(std::chrono::system_clock::now(), systemDeadline);
+
+	//A deadline in the past shouldn't block at all
+	event.wait_until(ULCommonUtils::now() - timeout);
+}
+
+TEST_F(EventTests, NotifyWakesUpWaiter)
+{
+	mtInternal::Event event;
+	std::atomic<bool> woken = false;
+
+	std::thread waiter([&event, &woken]()
+	{
+		event.wait();
+		woken = true;
+	});
+
+	std::this_thread::sleep_for(timeout);
+	ASSERT_FALSE(woken.load());
+	event.notify();
+	waiter.join();
+	ASSERT_TRUE(woken.load());
+}
+
+TEST_F(EventTests, WaitWithApplicationLock)
+{
+	mtInternal::Event event;
+	stdMutex mutex;
+	bool flag = false;
+
+	std::thread notifier([&event, &mutex, &flag]()
+	{
+		//Would deadlock if the waiter didn't release the lock while waiting
+		stdUniqueLock lock(mutex);
+		flag = true;
+		lock.unlock();
+		event.notify();
+	});
+
+	stdUniqueLock lock(mutex);
+	while (!flag)
+		event.wait(lock);
+	ASSERT_TRUE(lock.owns_lock());
+	lock.unlock();
+	notifier.join();
+}
+
+//Measures the round trip of a signal sent to a sleeping thread and signalled back
+template <class EventType>
+std::vector<int64_t> measurePingPong(size_t numRoundTrips)
+{
+	EventType ping;
+	EventType pong;
+	std::vector<int64_t> roundTrips;
+	roundTrips.reserve(numRoundTrips);
+
+	std::thread responder([&ping, &pong, numRoundTrips]()
+	{
+		for (size_t i = 0; i < numRoundTrips; i++)
+		{
+			ping.wait();
+			pong.notify_one();
+		}
+	});
+
+	for (size_t i = 0; i < numRoundTrips; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		ping.notify_one();
+		pong.wait();
+		roundTrips.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	responder.join();
+	std::sort(roundTrips.begin(), roundTrips.end());
+	return roundTrips;
+}
+
+TEST_F(EventTests, WakeupLatencyVsConditionVariable)
+{
+	size_t numRoundTrips = 20000;
+	auto percentile = [](const std::vector<int64_t>& sorted, double p) { return sorted[(size_t)(p * (sorted.size() - 1))]; };
+
+	auto condVar = measurePingPong<mtInternal::ConditionVariable>(numRoundTrips);
+	auto event = measurePingPong<mtInternal::Event>(numRoundTrips);
+	std::cout << "Wakeup round trip(ns) over " << numRoundTrips << " samples, p50/p99: ConditionVariable = "
+		<< percentile(condVar, 0.5) << "/" << percentile(condVar, 0.99) << ", Event = "
+		<< percentile(event, 0.5) << "/" << percentile(event, 0.99) << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,222 @@
+#include <ThreadPool.hpp>
+#include <gtest/gtest.h>
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+
+namespace mt = ULMTTools;
+
+struct FutureTests : ::testing::Test
+{
+	std::chrono::milliseconds timeout;
+
+	virtual void SetUp()
+	{
+		timeout = std::chrono::milliseconds(50);
+	}
+};
+
+TEST_F(FutureTests, SubmitReturnsResult)
+{
+	mt::WorkerThread worker;
+	mt::ThreadPool pool(4);
+	mt::ThreadPool stealingPool(4, mt::PoolMode::WorkStealing);
+
+	ASSERT_EQ(42, worker.submit([]() { return 42; }).get());
+	ASSERT_EQ("pool", pool.submit([]() { return std::string("pool"); }).get());
+	ASSERT_EQ(7, stealingPool.submit([]() { return 7; }).get());
+
+	bool ran = false;
+	worker.submit([&ran]() { ran = true; }).get();
+	ASSERT_TRUE(ran);
+}
+
+TEST_F(FutureTests, MoveOnlyResult)
+{
+	mt::WorkerThread worker;
+	std::unique_ptr<int> result = worker.submit([]() { return std::make_unique<int>(5); }).get();
+	ASSERT_EQ(5, *result);
+}
+
+TEST_F(FutureTests, ExceptionReachesGet)
+{
+	mt::WorkerThread worker;
+	auto future = worker.submit([]() -> int { throw std::logic_error("failed"); });
+	ASSERT_THROW(future.get(), std::logic_error);
+	ASSERT_FALSE(future.valid());
+}
+
+TEST_F(FutureTests, WaitForTimesOut)
+{
+	mt::WorkerThread worker;
+	mt::Promise<void> gate;
+	auto gateFuture = gate.get_future();
+	auto future = worker.submit([&gateFuture]() { gateFuture.wait(); return 1; });
+
+	ASSERT_FALSE(future.wait_for(timeout));
+	ASSERT_FALSE(future.ready());
+	gate.set_value();
+	ASSERT_TRUE(future.wait_for(std::chrono::seconds(5)));
+	ASSERT_EQ(1, future.get());
+}
+
+TEST_F(FutureTests, ThenRunsInlineOnCompletingWorker)
+{
+	mt::WorkerThread worker;
+	mt::Promise<void> gate;
+	auto gateFuture = gate.get_future();
+
+	auto workerId = worker.submit([]() { return std::this_thread::get_id(); }).get();
+	//The gate makes sure then() is attached before the task completes
+	auto future = worker.submit([&gateFuture]() { gateFuture.wait(); return 20; })
+		.then([](int value) { return std::make_pair(value + 1, std::this_thread::get_id()); });
+
+	gate.set_value();
+	auto result = future.get();
+	ASSERT_EQ(21, result.first);
+	ASSERT_EQ(workerId, result.second);
+}
+
+TEST_F(FutureTests, ThenOnReadyFutureRunsRightAway)
+{
+	mt::WorkerThread worker;
+	auto future = worker.submit([]() { return 1; });
+	future.wait();
+
+	std::thread::id continuationThread;
+	auto chained = future.then([&continuationThread](int value) { continuationThread = std::this_thread::get_id(); return value * 2; });
+	ASSERT_TRUE(chained.ready());
+	ASSERT_EQ(std::this_thread::get_id(), continuationThread);
+	ASSERT_EQ(2, chained.get());
+}
+
+TEST_F(FutureTests, ThenOnExecutor)
+{
+	mt::WorkerThread worker;
+	mt::WorkerThread other;
+	auto otherId = other.submit([]() { return std::this_thread::get_id(); }).get();
+
+	auto future = worker.submit([]() { return 3; })
+		.then(other, [](int value) { return std::make_pair(value, std::this_thread::get_id()); });
+
+	auto result = future.get();
+	ASSERT_EQ(3, result.first);
+	ASSERT_EQ(otherId, result.second);
+}
+
+TEST_F(FutureTests, ExceptionSkipsContinuations)
+{
+	mt::WorkerThread worker;
+	bool continuationRan = false;
+	auto future = worker.submit([]() -> int { throw std::logic_error("failed"); })
+		.then([&continuationRan](int value) { continuationRan = true; return value; })
+		.then([&continuationRan](int) { continuationRan = true; });
+
+	ASSERT_THROW(future.get(), std::logic_error);
+	ASSERT_FALSE(continuationRan);
+}
+
+TEST_F(FutureTests, BrokenPromise)
+{
+	mt::Future<int> future;
+	{
+		mt::Promise<int> promise;
+		future = promise.get_future();
+	}
+
+	try
+	{
+		future.get();
+		FAIL() << "Expected std::future_error";
+	}
+	catch (const std::future_error& err)
+	{
+		ASSERT_EQ(std::future_errc::broken_promise, err.code());
+	}
+}
+
+TEST_F(FutureTests, WhenAll)
+{
+	mt::ThreadPool pool(4, mt::PoolMode::WorkStealing);
+	std::vector<mt::Future<int>> futures;
+	for (int i = 0; i < 100; i++)
+		futures.push_back(pool.submit([i]() { return i; }));
+	futures.push_back(pool.submit([]() -> int { throw std::logic_error("failed"); }));
+
+	auto all = mt::when_all(std::move(futures)).get();
+	ASSERT_EQ(101, all.size());
+	for (int i = 0; i < 100; i++)
+	{
+		ASSERT_TRUE(all[i].ready());
+		ASSERT_EQ(i, all[i].get());
+	}
+	ASSERT_THROW(all[100].get(), std::logic_error);
+
+	ASSERT_TRUE(mt::when_all(std::vector<mt::Future<int>>()).get().empty());
+}
+
+TEST_F(FutureTests, WhenAny)
+{
+	mt::ThreadPool pool(2);
+	mt::Promise<void> gate;
+	auto gateFuture = gate.get_future();
+
+	std::vector<mt::Future<int>> futures;
+	futures.push_back(pool.submit([&gateFuture]() { gateFuture.wait(); return 1; }));
+	futures.push_back(pool.submit([]() { return 2; }));
+
+	auto any = mt::when_any(std::move(futures)).get();
+	ASSERT_EQ(1, any.index);
+	ASSERT_EQ(2, any.futures[1].get());
+
+	//The rest are handed back still usable
+	gate.set_value();
+	ASSERT_EQ(1, any.futures[0].get());
+}
+
+TEST_F(FutureTests, AllocationsPerSubmitVsStdPromise)
+{
+	const size_t numRoundTrips = 10000;
+	mt::WorkerThread worker;
+
+	auto measure = [&](auto roundTrip)
+	{
+		//Warm up, so that the shared states are already in circulation
+		for (size_t i = 0; i < numRoundTrips; i++)
+			roundTrip(i);
+
+		size_t allocationsBefore = AllocationCounter::numAllocations;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < numRoundTrips; i++)
+			roundTrip(i);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::make_pair(AllocationCounter::numAllocations - allocationsBefore, std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+	};
+
+	auto submitted = measure([&worker](size_t i)
+		{
+			if (i != worker.submit([i]() { return i; }).get())
+				throw std::logic_error("wrong result");
+		});
+
+	auto handMade = measure([&worker](size_t i)
+		{
+			std::promise<size_t> promise;
+			auto future = promise.get_future();
+			worker.push([i, promise = std::move(promise)]() mutable { promise.set_value(i); });
+			if (i != future.get())
+				throw std::logic_error("wrong result");
+		});
+
+	std::cout << numRoundTrips << " round trips, submit(): " << submitted.first << " allocations in " << submitted.second.count()
+		<< "us, std::promise: " << handMade.first << " allocations in " << handMade.second.count() << "us" << std::endl;
+	ASSERT_LT(submitted.first, handMade.first);
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
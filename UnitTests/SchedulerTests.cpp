@@ -0,0 +1,610 @@
+#include <TaskScheduler.hpp>
+#include <Future.hpp>
+#include <ThreadPool.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace mt = ULMTTools;
+namespace mtInternal = mtInternalUtils;
+
+struct SchedulerTests : ::testing::TestWithParam<mt::TimerBackend>
+{
+	mt::SchedulerOptions options()
+	{
+		mt::SchedulerOptions schedulerOptions;
+		schedulerOptions.backend = GetParam();
+		return schedulerOptions;
+	}
+};
+
+TEST_P(SchedulerTests, TasksRunAtOrAfterTheirTime)
+{
+	mt::TaskScheduler scheduler(options());
+	const size_t numTasks = 500;
+	std::mt19937 random(7);
+	std::vector<time_point> due(numTasks);
+	std::vector<time_point> ran(numTasks);
+	std::atomic<size_t> numRun = 0;
+	mtInternal::ConditionVariable cond;
+
+	auto start = ULCommonUtils::now();
+	for (size_t i = 0; i < numTasks; i++)
+	{
+		due[i] = start + std::chrono::microseconds(random() % 200000);
+		scheduler.push(due[i], [&, i]()
+			{
+				ran[i] = ULCommonUtils::now();
+				if (numTasks == ++numRun)
+					cond.notify_one();
+			});
+	}
+
+	cond.wait();
+	for (size_t i = 0; i < numTasks; i++)
+	{
+		ASSERT_GE(ran[i], due[i]);
+		ASSERT_LT(ran[i] - due[i], std::chrono::milliseconds(50));
+	}
+}
+
+TEST_P(SchedulerTests, PastAndFarFutureTimes)
+{
+	mt::TaskScheduler scheduler(options());
+	std::atomic<int> numRun = 0;
+	scheduler.push(ULCommonUtils::now() - std::chrono::hours(1), [&]() { numRun++; });
+	scheduler.push(ULCommonUtils::now() + std::chrono::hours(24 * 1000), [&]() { numRun += 100; });
+	mt::Promise<void> ran;
+	auto future = ran.get_future();
+	scheduler.push(ULCommonUtils::now() + std::chrono::milliseconds(20), [&]() { ran.set_value(); });
+	future.get();
+	ASSERT_EQ(1, numRun.load());
+}
+
+TEST_P(SchedulerTests, CancelledTasksDontRun)
+{
+	mt::TaskScheduler scheduler(options());
+	const size_t numTasks = 1000;
+	std::vector<std::atomic<bool>> ran(numTasks);
+	std::vector<mt::TimerHandle> handles;
+	auto start = ULCommonUtils::now();
+	for (size_t i = 0; i < numTasks; i++)
+		handles.push_back(scheduler.push(start + std::chrono::milliseconds(50 + i % 50), [&ran, i]() { ran[i] = true; }));
+
+	//Every other one, cancelling twice only succeeds once
+	for (size_t i = 0; i < numTasks; i += 2)
+	{
+		ASSERT_TRUE(handles[i].cancel());
+		ASSERT_FALSE(handles[i].cancel());
+	}
+
+	mt::Promise<void> done;
+	auto future = done.get_future();
+	scheduler.push(start + std::chrono::milliseconds(150), [&]() { done.set_value(); });
+	future.get();
+	for (size_t i = 0; i < numTasks; i++)
+		ASSERT_EQ(i % 2 == 1, ran[i].load());
+
+	//Too late once a task has run
+	ASSERT_FALSE(handles[1].cancel());
+	ASSERT_FALSE(mt::TimerHandle().cancel());
+}
+
+TEST_P(SchedulerTests, StaleHandleDoesntCancelAReusedEntry)
+{
+	mt::TaskScheduler scheduler(options());
+	mt::Promise<void> first;
+	auto firstRan = first.get_future();
+	auto stale = scheduler.push(ULCommonUtils::now(), [&]() { first.set_value(); });
+	firstRan.get();
+
+	//The entry of the first task is given back and handed out again to the following ones
+	std::atomic<int> numRun = 0;
+	mt::Promise<void> done;
+	auto future = done.get_future();
+	for (int i = 0; i < 10; i++)
+		scheduler.push(ULCommonUtils::now() + std::chrono::milliseconds(20), [&]() { numRun++; });
+	scheduler.push(ULCommonUtils::now() + std::chrono::milliseconds(30), [&]() { done.set_value(); });
+	ASSERT_FALSE(stale.cancel());
+	future.get();
+	ASSERT_EQ(10, numRun.load());
+}
+
+TEST_P(SchedulerTests, CancelledEntriesAreFreed)
+{
+	mt::TaskScheduler scheduler(options());
+	auto due = ULCommonUtils::now() + std::chrono::milliseconds(200);
+	std::vector<mt::TimerHandle> handles;
+	for (int i = 0; i < 100; i++)
+		handles.push_back(scheduler.push(due, []() {}));
+	for (auto& handle : handles)
+		handle.cancel();
+
+	//Dropped at the next wakeup from the wheel, while the map holds on to them till their time
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(mt::TimerBackend::TimingWheel == GetParam() ? 0 : 100, scheduler.numCancelledResident());
+
+	mt::Promise<void> done;
+	auto future = done.get_future();
+	scheduler.push(due + std::chrono::milliseconds(10), [&]() { done.set_value(); });
+	future.get();
+	ASSERT_EQ(0, scheduler.numCancelledResident());
+}
+
+TEST_P(SchedulerTests, SlackCoalescesWakeups)
+{
+	//Heartbeats spread over nanosecond offsets, with and without a slack
+	const size_t numTasks = 2000;
+	const duration slack = std::chrono::milliseconds(10);
+	mt::SchedulerStats stats[2];
+	for (int withSlack = 0; withSlack < 2; withSlack++)
+	{
+		mt::SchedulerOptions schedulerOptions = options();
+		schedulerOptions.slack = withSlack ? slack : duration::zero();
+		mt::TaskScheduler scheduler(schedulerOptions);
+		std::mt19937 random(17);
+		std::vector<time_point> due(numTasks);
+		std::vector<time_point> ran(numTasks);
+		std::atomic<size_t> numRun = 0;
+		mtInternal::ConditionVariable cond;
+
+		auto start = ULCommonUtils::now() + std::chrono::milliseconds(10);
+		for (size_t i = 0; i < numTasks; i++)
+		{
+			due[i] = start + std::chrono::nanoseconds(random() % 200000000);
+			scheduler.push(due[i], [&, i]()
+				{
+					ran[i] = ULCommonUtils::now();
+					if (numTasks == ++numRun)
+						cond.notify_one();
+				});
+		}
+
+		cond.wait();
+		for (size_t i = 0; i < numTasks; i++)
+		{
+			ASSERT_GE(ran[i], due[i]);
+			ASSERT_LT(ran[i] - due[i], slack + std::chrono::milliseconds(50));
+		}
+
+		stats[withSlack] = scheduler.stats();
+		ASSERT_EQ(numTasks, stats[withSlack].numFired);
+		std::cout << (withSlack ? "10ms slack: " : "no slack:   ") << stats[withSlack].numFiringWakeups << " firing wakeups out of "
+			<< stats[withSlack].numWakeups << " for " << stats[withSlack].numFired << " tasks" << std::endl;
+	}
+
+	ASSERT_LT(stats[1].numFiringWakeups * 3, stats[0].numFiringWakeups);
+}
+
+TEST_P(SchedulerTests, PeriodicTasks)
+{
+	mt::TaskScheduler scheduler(options());
+	auto start = ULCommonUtils::now();
+	std::vector<time_point> runs;
+	std::atomic<int> numSelfCancellingRuns = 0;
+	std::atomic<bool> selfCancelled = false;
+	mt::TimerHandle selfCancelling;
+	stdMutex mutex;
+
+	auto handle = scheduler.push_periodic(start, std::chrono::milliseconds(10), [&]() { runs.push_back(ULCommonUtils::now()); });
+	{
+		//Cancelled by its own third run
+		stdUniqueLock lock(mutex);
+		selfCancelling = scheduler.push_periodic(start, std::chrono::milliseconds(5), [&]()
+			{
+				stdUniqueLock lock(mutex);
+				if (3 == ++numSelfCancellingRuns)
+				{
+					//Asserted on the test thread, a failure on the scheduler thread wouldn't end the test
+					selfCancelled = selfCancelling.cancel();
+				}
+			});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(105));
+	ASSERT_TRUE(handle.cancel());
+	ASSERT_FALSE(handle.cancel());
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	//Every run on its own slot of the period, none after the cancellation
+	ASSERT_GE(runs.size(), 10);
+	ASSERT_LE(runs.size(), 12);
+	for (size_t i = 0; i < runs.size(); i++)
+		ASSERT_GE(runs[i], start + std::chrono::milliseconds(10) * static_cast<int>(i));
+	ASSERT_TRUE(selfCancelled.load());
+	ASSERT_EQ(3, numSelfCancellingRuns.load());
+	ASSERT_THROW(scheduler.push_periodic(start, duration::zero(), []() {}), std::invalid_argument);
+}
+
+TEST_P(SchedulerTests, OverrunPolicies)
+{
+	//A 10ms period whose second run takes 35ms, overrunning the three ticks due at 20, 30 and 40ms
+	auto runPeriodic = [this](mt::OverrunPolicy overrun, uint64_t& numMissed)
+	{
+		mt::TaskScheduler scheduler(options());
+		std::vector<duration> runs;
+		mt::PeriodicOptions periodic;
+		periodic.overrun = overrun;
+		auto start = ULCommonUtils::now() + std::chrono::milliseconds(10);
+		//Waiting for the runs rather than for a time, which a hiccup of the machine would leave with fewer runs
+		mt::Promise<void> sixRuns;
+		auto ran = sixRuns.get_future();
+		auto handle = scheduler.push_periodic(start, std::chrono::milliseconds(10), periodic, [&]()
+			{
+				if (6 == runs.size())
+					return;
+				runs.push_back(ULCommonUtils::now() - start);
+				if (2 == runs.size())
+					std::this_thread::sleep_for(std::chrono::milliseconds(35));
+				if (6 == runs.size())
+					sixRuns.set_value();
+			});
+
+		ran.get();
+		//Before the cancellation, after which the node may be freed
+		numMissed = handle.numMissedTicks();
+		EXPECT_TRUE(handle.cancel());
+		return runs;
+	};
+
+	uint64_t numMissed = 0;
+	//The three ticks run back to back after the long run, the first two out of their own period
+	auto runs = runPeriodic(mt::OverrunPolicy::CatchUp, numMissed);
+	ASSERT_LT(runs[4] - runs[2], std::chrono::milliseconds(5));
+	ASSERT_GE(numMissed, 2);
+
+	//The three ticks are dropped, the next runs are the ones due at 50 and 60ms, on the original phase
+	runs = runPeriodic(mt::OverrunPolicy::Skip, numMissed);
+	ASSERT_GE(runs[2], std::chrono::milliseconds(50));
+	ASSERT_GE(runs[3], std::chrono::milliseconds(60));
+	ASSERT_GE(numMissed, 3);
+
+	//The next run is a period after the end of the long one, none missed since the runs start on time(but for a hiccup of the machine)
+	runs = runPeriodic(mt::OverrunPolicy::FixedDelay, numMissed);
+	ASSERT_GE(runs[2] - runs[1], std::chrono::milliseconds(45));
+	ASSERT_LE(numMissed, 1);
+
+	//On an executor the scheduler doesn't see the end of a run, only its hand-off
+	mt::TaskScheduler executorScheduler(std::make_shared<mt::WorkerThread>(), options());
+	mt::PeriodicOptions periodic;
+	for (auto overrun : { mt::OverrunPolicy::Skip, mt::OverrunPolicy::FixedDelay })
+	{
+		periodic.overrun = overrun;
+		ASSERT_THROW(executorScheduler.push_periodic(ULCommonUtils::now(), std::chrono::milliseconds(10), periodic, []() {}), std::invalid_argument);
+	}
+	periodic.overrun = mt::OverrunPolicy::CatchUp;
+	ASSERT_TRUE(executorScheduler.push_periodic(ULCommonUtils::now(), std::chrono::milliseconds(10), periodic, []() {}).cancel());
+}
+
+TEST_P(SchedulerTests, JitteredPeriodicTasks)
+{
+	mt::TaskScheduler scheduler(options());
+	std::vector<duration> lateness;
+	mt::PeriodicOptions periodic;
+	periodic.jitter = std::chrono::milliseconds(8);
+	auto start = ULCommonUtils::now() + std::chrono::milliseconds(10);
+	mt::Promise<void> twentyRuns;
+	auto ran = twentyRuns.get_future();
+	auto handle = scheduler.push_periodic(start, std::chrono::milliseconds(10), periodic, [&]()
+		{
+			if (20 == lateness.size())
+				return;
+			lateness.push_back(ULCommonUtils::now() - (start + std::chrono::milliseconds(10) * static_cast<int>(lateness.size())));
+			if (20 == lateness.size())
+				twentyRuns.set_value();
+		});
+
+	ran.get();
+	ASSERT_TRUE(handle.cancel());
+
+	//Each run somewhere in its own [t, t + jitter), the jitter not accumulating over the runs
+	//Looking at the median, as a hiccup of the machine makes the run due then late as well as the next ones
+	std::sort(lateness.begin() + 1, lateness.end());
+	ASSERT_GE(lateness[1], duration::zero());
+	ASSERT_LT(lateness[lateness.size() / 2], std::chrono::milliseconds(10));
+	ASSERT_GE(lateness[lateness.size() / 2] - lateness[1], std::chrono::milliseconds(1));
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, SchedulerTests, ::testing::Values(mt::TimerBackend::OrderedMap, mt::TimerBackend::TimingWheel));
+
+TEST(ExecutorTests, SlowTasksDontDelayTheOthers)
+{
+	//10 tasks taking 20ms each due together, and a quick one due right after them
+	auto lateness = [](mt::TaskScheduler& scheduler)
+	{
+		auto due = ULCommonUtils::now() + std::chrono::milliseconds(10);
+		for (int i = 0; i < 10; i++)
+			scheduler.push(due, []() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+
+		mt::Promise<duration> ran;
+		auto future = ran.get_future();
+		auto quickDue = due + std::chrono::milliseconds(1);
+		scheduler.push(quickDue, [&ran, quickDue]() { ran.set_value(ULCommonUtils::now() - quickDue); });
+		return future.get();
+	};
+
+	mt::TaskScheduler inlineScheduler;
+	ASSERT_GE(lateness(inlineScheduler), std::chrono::milliseconds(150));
+
+	auto pool = std::make_shared<mt::ThreadPool>(12);
+	mt::TaskScheduler pooledScheduler(pool);
+	ASSERT_LT(lateness(pooledScheduler), std::chrono::milliseconds(15));
+
+	//The tasks end up on the worker's thread
+	auto worker = std::make_shared<mt::WorkerThread>();
+	mt::Promise<std::thread::id> workerId;
+	auto workerIdFuture = workerId.get_future();
+	worker->push([&]() { workerId.set_value(std::this_thread::get_id()); });
+	mt::TaskScheduler workerScheduler(mt::makeTaskExecutor(worker));
+	mt::Promise<std::thread::id> ranOn;
+	auto future = ranOn.get_future();
+	workerScheduler.push(ULCommonUtils::now(), [&]() { ranOn.set_value(std::this_thread::get_id()); });
+	ASSERT_EQ(workerIdFuture.get(), future.get());
+}
+
+TEST(TimerFdTests, OwnThread)
+{
+	mt::SchedulerOptions options;
+	options.wakeup = mt::SchedulerWakeup::TimerFd;
+	mt::TaskScheduler scheduler(options);
+	ASSERT_NE(-1, scheduler.fd());
+	const size_t numTasks = 200;
+	std::mt19937 random(23);
+	std::vector<time_point> due(numTasks);
+	std::vector<time_point> ran(numTasks);
+	std::atomic<size_t> numRun = 0;
+	mtInternal::ConditionVariable cond;
+
+	auto start = ULCommonUtils::now();
+	for (size_t i = 0; i < numTasks; i++)
+	{
+		due[i] = start + std::chrono::microseconds(random() % 100000);
+		scheduler.push(due[i], [&, i]()
+			{
+				ran[i] = ULCommonUtils::now();
+				if (numTasks == ++numRun)
+					cond.notify_one();
+			});
+	}
+
+	cond.wait();
+	for (size_t i = 0; i < numTasks; i++)
+		ASSERT_GE(ran[i], due[i]);
+}
+
+TEST(TimerFdTests, ExternalEpollLoop)
+{
+	mt::SchedulerOptions options;
+	options.wakeup = mt::SchedulerWakeup::TimerFd;
+	options.externalLoop = true;
+	mt::TaskScheduler scheduler(options);
+
+	//The application's loop, which would be watching its sockets as well
+	int epollFd = epoll_create1(0);
+	epoll_event event{};
+	event.events = EPOLLIN;
+	ASSERT_EQ(0, epoll_ctl(epollFd, EPOLL_CTL_ADD, scheduler.fd(), &event));
+	std::atomic<bool> stop = false;
+	std::thread::id loopId;
+	std::thread loop([&]()
+		{
+			loopId = std::this_thread::get_id();
+			while (!stop)
+			{
+				epoll_event ready[4];
+				if (epoll_wait(epollFd, ready, 4, -1) > 0)
+					scheduler.poll();
+			}
+		});
+
+	std::atomic<int> numRun = 0;
+	std::atomic<bool> onLoopThread = true;
+	auto start = ULCommonUtils::now();
+	for (int i = 1; i <= 10; i++)
+	{
+		auto due = start + std::chrono::milliseconds(5 * i);
+		scheduler.push(due, [&, due]()
+			{
+				onLoopThread = onLoopThread && std::this_thread::get_id() == loopId && ULCommonUtils::now() >= due;
+				numRun++;
+			});
+	}
+	auto cancelled = scheduler.push(start + std::chrono::milliseconds(20), [&]() { numRun += 100; });
+	ASSERT_TRUE(cancelled.cancel());
+
+	mt::Promise<void> done;
+	auto future = done.get_future();
+	scheduler.push(start + std::chrono::milliseconds(60), [&]() { stop = true; done.set_value(); });
+	future.get();
+	loop.join();
+	close(epollFd);
+
+	ASSERT_EQ(10, numRun.load());
+	ASSERT_TRUE(onLoopThread.load());
+}
+
+TEST(TimerFdTests, InvalidUse)
+{
+	mt::SchedulerOptions options;
+	options.externalLoop = true;
+	ASSERT_THROW(mt::TaskScheduler scheduler(options), std::invalid_argument);
+
+	mt::TaskScheduler scheduler;
+	ASSERT_EQ(-1, scheduler.fd());
+	ASSERT_THROW(scheduler.poll(), std::logic_error);
+}
+
+TEST(SlackTests, PicksARoundTimeWithinTheWindow)
+{
+	std::mt19937_64 random(19);
+	auto base = ULCommonUtils::now();
+	for (int i = 0; i < 10000; i++)
+	{
+		time_point t = base + std::chrono::nanoseconds(random() % 1000000000000ull);
+		duration slack(static_cast<duration::rep>(random() % 100000000));
+		time_point fireAt = mtInternal::applySlack(t, slack);
+		ASSERT_GE(fireAt, t);
+		ASSERT_LE(fireAt, t + slack);
+	}
+
+	//Windows that overlap end up on the same time even with different slacks, as long as the roundest time of the one is
+	//in the other, hence a fixed time rather than one off the clock
+	time_point t = time_point(std::chrono::seconds(1700000000)) + std::chrono::microseconds(1000003);
+	ASSERT_EQ(mtInternal::applySlack(t, std::chrono::milliseconds(5)), mtInternal::applySlack(t + std::chrono::microseconds(7), std::chrono::milliseconds(4)));
+	ASSERT_EQ(t, mtInternal::applySlack(t, duration::zero()));
+}
+
+TEST(TimingWheelTests, FiresExactlyTheDueItemsAcrossAllLevels)
+{
+	//Logical time, so the wheel can be driven through years of ticks
+	auto origin = ULCommonUtils::now();
+	mtInternal::TimingWheel<size_t> wheel(std::chrono::milliseconds(1), origin);
+	mtInternal::TimerNodePool<size_t> pool;
+	std::mt19937_64 random(11);
+	std::vector<time_point> due;
+	std::vector<bool> fired;
+	auto schedule = [&](const time_point& t)
+	{
+		auto node = pool.allocate();
+		node->m_item = due.size();
+		node->m_time = t;
+		wheel.insert(node);
+		due.push_back(t);
+		fired.push_back(false);
+	};
+
+	//Spread over every level and the overflow list
+	for (int exponent = 0; exponent <= 40; exponent++)
+		for (int i = 0; i < 20; i++)
+			schedule(origin + std::chrono::microseconds(static_cast<int64_t>(random() % (1ull << exponent)) * 1000 + random() % 1000));
+
+	auto now = origin;
+	size_t numFired = 0;
+	while (numFired < due.size())
+	{
+		//Steps from a tick to almost 2 years, landing both on and off level boundaries
+		now += std::chrono::microseconds(static_cast<int64_t>(1ull << (random() % 46)) + random() % 1000);
+		wheel.expire(now, [&](mtInternal::TimerNode<size_t>* node)
+			{
+				size_t idx = *node->m_item;
+				pool.release(node);
+				ASSERT_FALSE(fired[idx]);
+				ASSERT_LE(due[idx], now);
+				fired[idx] = true;
+				numFired++;
+			});
+
+		//Never early and at most a tick late
+		for (size_t i = 0; i < due.size(); i++)
+			ASSERT_TRUE(fired[i] || due[i] + std::chrono::milliseconds(1) > now);
+
+		//Items added midway are placed relative to where the wheel is now
+		if (numFired < due.size() / 2)
+			schedule(now + std::chrono::milliseconds(static_cast<int64_t>(random() % 100000)));
+	}
+
+	ASSERT_EQ(0, wheel.size());
+}
+
+TEST(TimingWheelTests, MapVsWheel)
+{
+	//Pending items at random times over 10 seconds, then expired in 1ms steps as a scheduler thread would
+	auto ns = [](auto d) { return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()); };
+	for (size_t numItems : { 1000, 100000, 1000000 })
+		for (mt::TimerBackend backend : { mt::TimerBackend::OrderedMap, mt::TimerBackend::TimingWheel })
+		{
+			mt::SchedulerOptions options;
+			options.backend = backend;
+			mtInternal::TimerQueue<Task> queue(options);
+			mtInternal::TimerNodePool<Task> pool;
+			std::mt19937_64 random(13);
+			size_t numFired = 0;
+			auto origin = ULCommonUtils::now();
+
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < numItems; i++)
+			{
+				auto node = pool.allocate();
+				node->m_item.emplace([&numFired]() { numFired++; });
+				node->m_time = origin + std::chrono::nanoseconds(random() % 10000000000ull);
+				queue.insert(node);
+			}
+			auto inserted = std::chrono::steady_clock::now();
+
+			for (auto now = origin; now <= origin + std::chrono::seconds(11); now += std::chrono::milliseconds(1))
+				queue.expire(now, [&pool](mtInternal::TimerNode<Task>* node)
+					{
+						(*node->m_item)();
+						node->m_item.reset();
+						pool.release(node);
+					});
+			auto expired = std::chrono::steady_clock::now();
+
+			ASSERT_EQ(numItems, numFired);
+			std::cout << (mt::TimerBackend::OrderedMap == backend ? "map  " : "wheel") << " " << numItems << " pending: "
+				<< ns(inserted - start) / numItems << "ns per insert, " << ns(expired - inserted) / numItems << "ns per expiry" << std::endl;
+		}
+}
+
+TEST(SchedulerBenchmark, CancelChurn)
+{
+	//Timeouts armed and cancelled before they expire, as for requests answered in time
+	const size_t numTasks = 200000;
+	for (mt::TimerBackend backend : { mt::TimerBackend::OrderedMap, mt::TimerBackend::TimingWheel })
+	{
+		mt::SchedulerOptions options;
+		options.backend = backend;
+		mt::TaskScheduler scheduler(options);
+		std::atomic<size_t> numRun = 0;
+		size_t peakResident = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < numTasks; i++)
+		{
+			auto handle = scheduler.push(ULCommonUtils::now() + std::chrono::seconds(1), [&]() { numRun++; });
+			handle.cancel();
+			if (!(i % 1000))
+				peakResident = std::max(peakResident, scheduler.numCancelledResident());
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		ASSERT_EQ(0, numRun.load());
+		std::cout << (mt::TimerBackend::OrderedMap == backend ? "map  " : "wheel") << " "
+			<< std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / numTasks << "ns per push and cancel, "
+			<< peakResident << " cancelled entries resident at most" << std::endl;
+	}
+}
+
+TEST(SchedulerBenchmark, WakeupPrecision)
+{
+	//One task at a time, each due 1 to 2ms after it is pushed so that the scheduler thread is asleep when it comes due
+	const size_t numSamples = 500;
+	for (mt::SchedulerWakeup wakeup : { mt::SchedulerWakeup::Futex, mt::SchedulerWakeup::TimerFd })
+	{
+		mt::SchedulerOptions options;
+		options.wakeup = wakeup;
+		mt::TaskScheduler scheduler(options);
+		std::mt19937 random(29);
+		std::vector<int64_t> lateness;
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			auto due = ULCommonUtils::now() + std::chrono::microseconds(1000 + random() % 1000);
+			mt::Promise<int64_t> ran;
+			auto future = ran.get_future();
+			scheduler.push(due, [&ran, due]() { ran.set_value(std::chrono::duration_cast<std::chrono::nanoseconds>(ULCommonUtils::now() - due).count()); });
+			lateness.push_back(future.get());
+		}
+
+		std::sort(lateness.begin(), lateness.end());
+		ASSERT_GE(lateness.front(), 0);
+		std::cout << (mt::SchedulerWakeup::Futex == wakeup ? "futex  " : "timerfd") << " lateness(us) over " << numSamples << " wakeups, p50/p99/max: "
+			<< lateness[numSamples / 2] / 1000.0 << "/" << lateness[numSamples * 99 / 100] / 1000.0 << "/" << lateness.back() / 1000.0 << std::endl;
+	}
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+#include <Strand.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+namespace mt = ULMTTools;
+namespace mtInternal = mtInternalUtils;
+
+struct StrandTests : ::testing::TestWithParam<mt::PoolMode>
+{
+};
+
+TEST_P(StrandTests, TasksRunInOrderAndNeverConcurrently)
+{
+	const size_t numStrands = 8;
+	const size_t numProducers = 4;
+	const size_t numTasksPerProducer = 20000;
+	mt::ThreadPool pool(4, GetParam());
+
+	struct PerStrand
+	{
+		std::atomic<bool> running = false;
+		std::atomic<size_t> numOverlaps = 0;
+		std::vector<size_t> lastSeen = std::vector<size_t>(numProducers, 0);//Only touched from the strand's tasks
+		size_t numOutOfOrder = 0;
+		size_t numRun = 0;
+	};
+
+	std::vector<std::unique_ptr<mt::Strand>> strands;
+	std::vector<PerStrand> stats(numStrands);
+	for (size_t i = 0; i < numStrands; i++)
+		strands.push_back(std::make_unique<mt::Strand>(pool));
+
+	std::vector<std::thread> producers;
+	for (size_t p = 0; p < numProducers; p++)
+		producers.emplace_back([&, p]()
+			{
+				for (size_t seq = 1; seq <= numTasksPerProducer; seq++)
+				{
+					size_t s = seq % numStrands;
+					strands[s]->push([&stat = stats[s], p, seq]()
+						{
+							if (stat.running.exchange(true))
+								stat.numOverlaps++;
+							if (seq <= stat.lastSeen[p])
+								stat.numOutOfOrder++;
+							stat.lastSeen[p] = seq;
+							stat.numRun++;
+							stat.running = false;
+						});
+				}
+			});
+
+	for (auto& producer : producers)
+		producer.join();
+
+	//Destroying a strand waits for its pending tasks
+	strands.clear();
+
+	size_t totalRun = 0;
+	for (auto& stat : stats)
+	{
+		ASSERT_EQ(0, stat.numOverlaps.load());
+		ASSERT_EQ(0, stat.numOutOfOrder);
+		totalRun += stat.numRun;
+	}
+	ASSERT_EQ(numProducers * numTasksPerProducer, totalRun);
+}
+
+TEST_P(StrandTests, KeyedPushAndSubmit)
+{
+	mt::ThreadPool pool(4, GetParam());
+	mt::StrandGroup<std::string> group(pool, 16);
+
+	std::vector<std::string> keys = { "EURUSD", "GBPUSD", "USDJPY", "AUDUSD" };
+	std::map<std::string, std::vector<int>> seen;
+	stdMutex mutex;
+	for (int i = 0; i < 1000; i++)
+	{
+		const std::string& key = keys[i % keys.size()];
+		group.push(key, [&, key, i]()
+			{
+				stdUniqueLock lock(mutex);
+				seen[key].push_back(i);
+			});
+	}
+
+	//A task submitted last to a key's strand runs after everything pushed before it for that key
+	for (auto& key : keys)
+		group.strand(key).submit([]() {}).get();
+
+	for (auto& key : keys)
+	{
+		ASSERT_EQ(250, seen[key].size());
+		ASSERT_TRUE(std::is_sorted(seen[key].begin(), seen[key].end()));
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(PoolModes, StrandTests, ::testing::Values(mt::PoolMode::RoundRobin, mt::PoolMode::WorkStealing));
+
+TEST(StrandScaleTests, HundredThousandStrands)
+{
+	const size_t numStrands = 100000;
+	mt::ThreadPool pool(4, mt::PoolMode::WorkStealing);
+	mtInternal::ConditionVariable cond;
+	std::atomic<size_t> numRun = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	mt::StrandGroup<size_t> group(pool, numStrands);
+	auto created = std::chrono::steady_clock::now();
+
+	for (size_t round = 0; round < 2; round++)
+		for (size_t key = 0; key < numStrands; key++)
+			group.push(key, [&]()
+				{
+					if (2 * numStrands == ++numRun)
+						cond.notify_one();
+				});
+
+	cond.wait();
+	auto done = std::chrono::steady_clock::now();
+
+	auto ms = [](auto d) { return std::chrono::duration_cast<std::chrono::milliseconds>(d).count(); };
+	std::cout << numStrands << " strands created in " << ms(created - start) << "ms(" << sizeof(mt::Strand)
+		<< " bytes each plus the queue's stub node), 2 tasks on each ran in " << ms(done - created) << "ms" << std::endl;
+	ASSERT_EQ(2 * numStrands, numRun.load());
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+#include <TaskGraph.hpp>
+#include <gtest/gtest.h>
+
+namespace mt = ULMTTools;
+
+struct TaskGraphTests : ::testing::TestWithParam<mt::PoolMode>
+{
+};
+
+TEST_P(TaskGraphTests, NodesRunAfterTheirDependencies)
+{
+	mt::ThreadPool pool(4, GetParam());
+	mt::TaskGraph graph(pool);
+
+	//Layers of nodes, each depending on 2 nodes of the layer before, every node checks its inputs are done
+	const size_t numLayers = 20;
+	const size_t width = 50;
+	std::vector<std::atomic<size_t>> runs(numLayers * width);
+	std::atomic<size_t> numViolations = 0;
+	for (size_t layer = 0; layer < numLayers; layer++)
+		for (size_t i = 0; i < width; i++)
+		{
+			size_t id = layer * width + i;
+			graph.emplace([&, layer, i, id]()
+				{
+					if (layer && (runs[id].load() != runs[id - width].load() - 1 || runs[id].load() != runs[(layer - 1) * width + (i + 1) % width].load() - 1))
+						numViolations++;
+					runs[id]++;
+				});
+		}
+
+	for (size_t layer = 1; layer < numLayers; layer++)
+		for (size_t i = 0; i < width; i++)
+		{
+			graph.addEdge((layer - 1) * width + i, layer * width + i);
+			graph.addEdge((layer - 1) * width + (i + 1) % width, layer * width + i);
+		}
+
+	//Reused across runs, each run starting over from the same counters
+	for (int round = 1; round <= 50; round++)
+	{
+		graph.run().get();
+		for (auto& numRuns : runs)
+			ASSERT_EQ(round, numRuns.load());
+	}
+	ASSERT_EQ(0, numViolations.load());
+}
+
+TEST_P(TaskGraphTests, ExceptionSkipsTheRestOfTheRun)
+{
+	mt::ThreadPool pool(2, GetParam());
+	mt::TaskGraph graph(pool);
+	std::atomic<bool> shouldThrow = true;
+	std::atomic<int> numRun = 0;
+
+	auto first = graph.emplace([&]() { numRun++; if (shouldThrow) throw std::runtime_error("failed"); });
+	auto second = graph.emplace([&]() { numRun++; });
+	auto third = graph.emplace([&]() { numRun++; });
+	graph.addEdge(first, second);
+	graph.addEdge(second, third);
+
+	ASSERT_THROW(graph.run().get(), std::runtime_error);
+	ASSERT_EQ(1, numRun.load());
+
+	//The next run starts clean
+	shouldThrow = false;
+	graph.run().get();
+	ASSERT_EQ(4, numRun.load());
+}
+
+TEST_P(TaskGraphTests, CompletionCanBeChained)
+{
+	mt::ThreadPool pool(2, GetParam());
+	mt::TaskGraph graph(pool);
+	std::atomic<int> value = 0;
+	auto a = graph.emplace([&]() { value += 1; });
+	auto b = graph.emplace([&]() { value += 2; });
+	auto c = graph.emplace([&]() { value = value * 10; });
+	graph.addEdge(a, c);
+	graph.addEdge(b, c);
+
+	ASSERT_EQ(31, graph.run().then([&]() { return value + 1; }).get());
+}
+
+INSTANTIATE_TEST_SUITE_P(PoolModes, TaskGraphTests, ::testing::Values(mt::PoolMode::RoundRobin, mt::PoolMode::WorkStealing));
+
+TEST(TaskGraphValidationTests, CyclesAndChangesWhileRunning)
+{
+	mt::ThreadPool pool(2, mt::PoolMode::WorkStealing);
+	mt::TaskGraph graph(pool);
+
+	//An empty graph completes right away
+	graph.run().get();
+
+	std::atomic<bool> release = false;
+	auto a = graph.emplace([&]() { while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+	auto b = graph.emplace([]() {});
+	graph.addEdge(a, b);
+	ASSERT_THROW(graph.addEdge(a, 5), std::out_of_range);
+
+	auto future = graph.run();
+	ASSERT_THROW(graph.run(), std::logic_error);
+	ASSERT_THROW(graph.emplace([]() {}), std::logic_error);
+	release = true;
+	future.get();
+
+	graph.addEdge(b, a);
+	ASSERT_THROW(graph.run(), std::logic_error);
+}
+
+TEST(TaskGraphBenchmark, PipelineRuns)
+{
+	//A 4 stage pipeline over 16 independent instruments, run over and over
+	const size_t numInstruments = 16;
+	const size_t numStages = 4;
+	const int numRuns = 2000;
+	mt::ThreadPool pool(4, mt::PoolMode::WorkStealing);
+	mt::TaskGraph graph(pool);
+	std::atomic<size_t> numNodesRun = 0;
+
+	auto aggregate = graph.emplace([&]() { numNodesRun++; });
+	for (size_t instrument = 0; instrument < numInstruments; instrument++)
+	{
+		mt::TaskGraph::NodeId prev = graph.emplace([&]() { numNodesRun++; });
+		for (size_t stage = 1; stage < numStages; stage++)
+		{
+			mt::TaskGraph::NodeId curr = graph.emplace([&]() { numNodesRun++; });
+			graph.addEdge(prev, curr);
+			prev = curr;
+		}
+		graph.addEdge(prev, aggregate);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numRuns; i++)
+		graph.run().get();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	ASSERT_EQ(numRuns * graph.size(), numNodesRun.load());
+	std::cout << numRuns << " runs of a " << graph.size() << " node graph: "
+		<< std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / numRuns << "ns per run" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
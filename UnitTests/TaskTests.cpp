@@ -0,0 +1,106 @@
+#include <Task.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+//Counts the allocations made by the test thread, so the tests can check that small tasks never touch the heap
+static thread_local size_t numAllocations = 0;
+
+void* operator new(size_t size)
+{
+	++numAllocations;
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+struct TaskTests : ::testing::Test
+{
+	int numInvocations;
+
+	virtual void SetUp()
+	{
+		numInvocations = 0;
+	}
+};
+
+TEST_F(TaskTests, SmallClosuresDontAllocate)
+{
+	auto sharedState = std::make_shared<int>(0);
+	int* p1 = &numInvocations;
+	int* p2 = &numInvocations;
+	int* p3 = &numInvocations;
+
+	size_t allocationsBefore = numAllocations;
+	Task task([p1, p2, p3, sharedState]() { ++*p1; });
+	Task moved(std::move(task));
+	Task assigned;
+	assigned = std::move(moved);
+	assigned();
+	ASSERT_EQ(allocationsBefore, numAllocations);
+
+	ASSERT_EQ(1, numInvocations);
+	ASSERT_FALSE(task);
+	ASSERT_FALSE(moved);
+	ASSERT_TRUE(assigned);
+}
+
+TEST_F(TaskTests, LargeClosuresGoToHeap)
+{
+	char payload[MTTOOLS_TASK_INLINE_SIZE * 2] = {};
+	size_t allocationsBefore = numAllocations;
+	Task task([this, payload]() { numInvocations += 1 + payload[0]; });
+	ASSERT_EQ(allocationsBefore + 1, numAllocations);
+
+	//Moving a heap stored callable only moves the pointer
+	Task moved(std::move(task));
+	ASSERT_EQ(allocationsBefore + 1, numAllocations);
+	moved();
+	ASSERT_EQ(1, numInvocations);
+}
+
+TEST_F(TaskTests, MoveOnlyClosures)
+{
+	auto value = std::make_unique<int>(42);
+	Task task([this, value = std::move(value)]() { numInvocations = *value; });
+	Task moved(std::move(task));
+	moved();
+	ASSERT_EQ(42, numInvocations);
+}
+
+TEST_F(TaskTests, CapturesAreDestroyedWithTheTask)
+{
+	auto sharedState = std::make_shared<int>(0);
+	{
+		Task task([sharedState]() {});
+		ASSERT_EQ(2, sharedState.use_count());
+		Task moved(std::move(task));
+		ASSERT_EQ(2, sharedState.use_count());
+	}
+	ASSERT_EQ(1, sharedState.use_count());
+}
+
+TEST_F(TaskTests, EmptyTaskThrowsOnInvocation)
+{
+	Task task;
+	ASSERT_FALSE(task);
+	ASSERT_THROW(task(), std::bad_function_call);
+}
+
+int main(int argc, const char **argv)
+{
+	::testing::InitGoogleTest();
+	return RUN_ALL_TESTS();
+}
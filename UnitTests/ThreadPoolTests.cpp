@@ -1,5 +1,6 @@
 #include <ThreadPool.hpp>
 #include <gtest/gtest.h>
+#include <cmath>
 
 namespace mt = ULMTTools;
 namespace mtInternal = mtInternalUtils;
@@ -75,6 +76,27 @@ TEST_F(ThreadPoolTests, TestPushingTasksFromMultipleThreads)
 	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
 }
 
+TEST_F(ThreadPoolTests, TestPushBulk)
+{
+	mt::ThreadPool worker(numCores);
+	mtInternal::ConditionVariable cond;
+
+	std::vector<Task> tasks;
+	//Not a multiple of the no. of threads, to exercise the uneven split
+	for (int i = 1; i <= totalTasks + 1; i++)
+	{
+		tasks.emplace_back([this, &cond]()
+		{
+			if (totalTasks + 1 == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	worker.push_bulk(tasks.begin(), tasks.end());
+	cond.wait();
+	ASSERT_EQ(totalTasks + 1, taskExecutionCounter.load());
+}
+
 TEST_F(ThreadPoolTests, PerformanceVsSingleThreaded)
 {
 	uint8_t numThreads = 4;
@@ -133,6 +155,394 @@ TEST_F(ThreadPoolTests, PerformanceVsSingleThreaded)
 	std::cout << "Speedup with " << numTasks << " tasks and with each task  = " << numrepetetionsPerTask << " units and concurrency = " << (int)numThreads << " is " << speedup_mine << std::endl;
 }
 
+TEST_F(ThreadPoolTests, WorkStealingFromMultipleThreads)
+{
+	mt::ThreadPool pool(4, mt::PoolMode::WorkStealing);
+	mtInternal::ConditionVariable cond;
+
+	auto func = [this, &cond]()
+	{
+		if (totalTasks == ++taskExecutionCounter)
+			cond.notify_one();
+	};
+
+	std::thread threads[4];
+	for (int j = 0; j < 4; j++)
+	{
+		threads[j] = std::thread([this, &func, &pool]() {
+			for (int i = 1; i <= totalTasks / 4; i++)
+				pool.push(func);
+		});
+	}
+
+	for (int i = 0; i < 4; i++)
+		threads[i].join();
+
+	cond.wait();
+	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
+}
+
+TEST_F(ThreadPoolTests, WorkStealingTasksSpawningTasks)
+{
+	//Every task pushes 2 children till the given depth, so almost all the tasks are pushed from inside the pool
+	mt::ThreadPool pool(4, mt::PoolMode::WorkStealing);
+	mtInternal::ConditionVariable cond;
+	const int depth = 12;
+	const int numTasks = (1 << (depth + 1)) - 1;
+
+	std::function<void(int)> spawn = [&](int level)
+	{
+		if (level < depth)
+		{
+			pool.push([&spawn, level]() { spawn(level + 1); });
+			pool.push([&spawn, level]() { spawn(level + 1); });
+		}
+
+		if (numTasks == ++taskExecutionCounter)
+			cond.notify_one();
+	};
+
+	pool.push([&spawn]() { spawn(0); });
+	cond.wait();
+	ASSERT_EQ(numTasks, taskExecutionCounter.load());
+}
+
+TEST_F(ThreadPoolTests, WorkStealingKillProcessesPendingTasks)
+{
+	mtInternal::WorkStealingPool pool(std::vector<mt::ThreadOptions>(4));
+	std::vector<Task> tasks;
+	for (int i = 0; i < totalTasks; i++)
+		tasks.emplace_back([this]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); taskExecutionCounter++; });
+
+	pool.push_bulk(tasks.begin(), tasks.end());
+	pool.kill();
+	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
+	ASSERT_THROW(pool.push([]() {}), std::runtime_error);
+}
+
+TEST_F(ThreadPoolTests, WorkStealingSingleWorker)
+{
+	//The lone worker's share of the injector is all of it, never more than there is in it
+	mtInternal::WorkStealingPool pool(std::vector<mt::ThreadOptions>(1));
+	std::vector<Task> tasks;
+	for (int i = 0; i < 10; i++)
+		tasks.emplace_back([this]() { taskExecutionCounter++; });
+
+	pool.push_bulk(tasks.begin(), tasks.end());
+	for (int i = 0; i < 5; i++)
+		pool.push([this]() { taskExecutionCounter++; });
+	pool.kill();
+	ASSERT_EQ(15, taskExecutionCounter.load());
+}
+
+TEST_F(ThreadPoolTests, WorkStealingDequeEveryItemTakenOnce)
+{
+	//The owner pushes and pops at one end while the thieves steal from the other, every item must come out exactly once
+	const size_t numItems = 200000;
+	const size_t numThieves = 3;
+	mtInternal::WorkStealingDeque<size_t*> deque(4);//Small to exercise the growth while thieves are reading
+	std::vector<size_t> items(numItems);
+	std::vector<std::atomic<int>> timesTaken(numItems);
+	std::atomic<bool> ownerDone = false;
+
+	auto take = [&](size_t* item) { timesTaken[item - items.data()]++; };
+
+	std::vector<std::thread> thieves;
+	for (size_t i = 0; i < numThieves; i++)
+		thieves.emplace_back([&]()
+			{
+				size_t* item = nullptr;
+				while (!ownerDone || !deque.empty())
+					if (deque.steal(item))
+						take(item);
+			});
+
+	size_t* item = nullptr;
+	for (size_t i = 0; i < numItems; i++)
+	{
+		deque.push(&items[i]);
+		if (0 == i % 3 && deque.pop(item))
+			take(item);
+	}
+	while (deque.pop(item))
+		take(item);
+	ownerDone = true;
+
+	for (auto& thief : thieves)
+		thief.join();
+
+	for (size_t i = 0; i < numItems; i++)
+		ASSERT_EQ(1, timesTaken[i].load()) << "item " << i;
+}
+
+TEST_F(ThreadPoolTests, SkewedTaskDurationsRoundRobinVsWorkStealing)
+{
+	//Every 100th task takes 200 times longer than the rest, sleeping rather than spinning so that
+	//the difference shows even on a machine with fewer cores than workers
+	const size_t numThreads = 4;
+	const size_t numTasks = 800;
+	auto shortTask = std::chrono::microseconds(100);
+	auto longTask = std::chrono::milliseconds(20);
+
+	auto measure = [&](mt::PoolMode mode)
+	{
+		std::atomic<size_t> numExecuted = 0;
+		mtInternal::ConditionVariable cond;
+		mt::ThreadPool pool(numThreads, mode);
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < numTasks; i++)
+		{
+			auto sleepFor = (0 == i % 100) ? std::chrono::duration_cast<std::chrono::microseconds>(longTask) : shortTask;
+			pool.push([&, sleepFor]()
+				{
+					std::this_thread::sleep_for(sleepFor);
+					if (numTasks == ++numExecuted)
+						cond.notify_one();
+				});
+		}
+
+		cond.wait();
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	};
+
+	auto roundRobin = measure(mt::PoolMode::RoundRobin);
+	auto workStealing = measure(mt::PoolMode::WorkStealing);
+	std::cout << numTasks << " tasks with skewed durations on " << numThreads << " threads, round robin: " << roundRobin.count()
+		<< "ms, work stealing: " << workStealing.count() << "ms" << std::endl;
+}
+
+struct ParallelAlgorithmTests : ::testing::TestWithParam<mt::PoolMode>
+{
+};
+
+TEST_P(ParallelAlgorithmTests, ParallelForVisitsEveryIndexOnce)
+{
+	mt::ThreadPool pool(4, GetParam());
+	const size_t numItems = 100003;
+	std::vector<std::atomic<int>> visits(numItems);
+
+	pool.parallel_for(0, numItems, [&visits](size_t i) { visits[i]++; });
+	for (size_t i = 0; i < numItems; i++)
+		ASSERT_EQ(1, visits[i].load()) << "index " << i;
+
+	//Range form, every chunk but the last is at least 'grain' long
+	const size_t grain = 1000;
+	std::atomic<size_t> numShortChunks = 0;
+	pool.parallel_for(0, numItems, [&](size_t begin, size_t end)
+		{
+			if (end - begin < grain && end != numItems)
+				numShortChunks++;
+			for (size_t i = begin; i < end; i++)
+				visits[i]++;
+		}, grain);
+
+	ASSERT_EQ(0, numShortChunks.load());
+	for (size_t i = 0; i < numItems; i++)
+		ASSERT_EQ(2, visits[i].load()) << "index " << i;
+
+	//Empty range
+	pool.parallel_for(5, 5, [](size_t) { FAIL(); });
+}
+
+TEST_P(ParallelAlgorithmTests, ParallelReduce)
+{
+	mt::ThreadPool pool(4, GetParam());
+	const size_t numItems = 500000;
+	auto sum = pool.parallel_reduce(0, numItems, static_cast<size_t>(0), [](size_t i) { return i; }, std::plus<size_t>());
+	ASSERT_EQ(numItems * (numItems - 1) / 2, sum);
+
+	auto max = pool.parallel_reduce(0, numItems, static_cast<size_t>(0), [](size_t i) { return (i * 7919) % 100000; },
+		[](size_t a, size_t b) { return std::max(a, b); });
+	ASSERT_EQ(99999, max);
+}
+
+TEST_P(ParallelAlgorithmTests, ParallelInvoke)
+{
+	mt::ThreadPool pool(2, GetParam());
+	int a = 0, b = 0, c = 0;
+	pool.parallel_invoke([&a]() { a = 1; }, [&b]() { b = 2; }, [&c]() { c = 3; });
+	ASSERT_EQ(6, a + b + c);
+}
+
+TEST_P(ParallelAlgorithmTests, NestedLoopsFromInsideThePool)
+{
+	//Every worker is busy running an outer iteration, the inner loops still finish as their callers take part
+	mt::ThreadPool pool(2, GetParam());
+	std::atomic<size_t> numInner = 0;
+	pool.submit([&]()
+		{
+			pool.parallel_for(0, 4, [&](size_t)
+				{
+					pool.parallel_for(0, 1000, [&](size_t) { numInner++; });
+				}, 1);
+		}).get();
+
+	ASSERT_EQ(4000, numInner.load());
+}
+
+TEST_P(ParallelAlgorithmTests, ExceptionCallsOffTheLoop)
+{
+	mt::ThreadPool pool(4, GetParam());
+	std::atomic<size_t> numCalls = 0;
+	auto loop = [&]()
+	{
+		pool.parallel_for(0, 1000000, [&](size_t i)
+			{
+				numCalls++;
+				if (10 == i)
+					throw std::logic_error("failed");
+			});
+	};
+
+	ASSERT_THROW(loop(), std::logic_error);
+	ASSERT_LT(numCalls.load(), 1000000);
+}
+
+INSTANTIATE_TEST_SUITE_P(PoolModes, ParallelAlgorithmTests, ::testing::Values(mt::PoolMode::RoundRobin, mt::PoolMode::WorkStealing));
+
+TEST(ParallelAlgorithmScaling, RiskRecalcOverPositions)
+{
+	//Prices 500k positions with a bit of floating point work each and sums the exposure, from 1 thread to all the cores
+	const size_t numPositions = 500000;
+	auto price = [](size_t i)
+	{
+		double spot = 100.0 + static_cast<double>(i % 1000) / 10.0;
+		double vol = 0.1 + static_cast<double>(i % 37) / 100.0;
+		double t = 0.25 + static_cast<double>(i % 8) / 4.0;
+		return spot * std::exp(-0.05 * t) * (1.0 + vol * std::sqrt(t)) * std::log1p(spot / 100.0);
+	};
+
+	auto ms = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.0; };
+
+	auto start = std::chrono::steady_clock::now();
+	double expected = 0;
+	for (size_t i = 0; i < numPositions; i++)
+		expected += price(i);
+	auto sequential = std::chrono::steady_clock::now() - start;
+	std::cout << numPositions << " positions, sequential: " << ms(sequential) << "ms" << std::endl;
+
+	size_t maxThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	for (size_t numThreads = 1; numThreads <= maxThreads; numThreads++)
+	{
+		//The caller takes part as well, so numThreads - 1 workers make numThreads participants
+		mt::ThreadPool pool(std::max<size_t>(1, numThreads - 1), mt::PoolMode::WorkStealing);
+		start = std::chrono::steady_clock::now();
+		double total = pool.parallel_reduce(0, numPositions, 0.0, price, std::plus<double>(), 1024);
+		auto parallel = std::chrono::steady_clock::now() - start;
+
+		ASSERT_NEAR(expected, total, std::abs(expected) * 1e-9);
+		std::cout << "  " << numThreads << " thread(s): " << ms(parallel) << "ms, speedup " << ms(sequential) / ms(parallel) << std::endl;
+	}
+}
+
+TEST_F(ThreadPoolTests, ElasticGrowsWithTheBacklogAndRetiresIdleWorkers)
+{
+	mt::ElasticPoolOptions options;
+	options.minThreads = 1;
+	options.maxThreads = 4;
+	options.idleTimeout = std::chrono::milliseconds(100);
+	mt::ThreadPool pool(options);
+	ASSERT_EQ(1, pool.numThreads());
+
+	//Every task blocks its worker till released, so each push beyond the busy workers finds a backlog
+	std::atomic<bool> release = false;
+	for (int i = 0; i < totalTasks; i++)
+		pool.push([&]()
+			{
+				while (!release)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				taskExecutionCounter++;
+			});
+
+	ASSERT_EQ(options.maxThreads, pool.numThreads());
+	release = true;
+	pool.submit([]() {}).get();
+
+	//All but the minimum retire once they have been idle for the timeout
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (pool.numThreads() > options.minThreads && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	ASSERT_EQ(options.minThreads, pool.numThreads());
+	ASSERT_EQ(options.maxThreads, pool.peakThreads());
+	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
+
+	//And the pool grows again on the next burst
+	release = false;
+	for (size_t i = 0; i < options.maxThreads; i++)
+		pool.push([&]() { while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+	ASSERT_EQ(options.maxThreads, pool.numThreads());
+	release = true;
+}
+
+TEST_F(ThreadPoolTests, ElasticGrowsOnWaitTime)
+{
+	mt::ElasticPoolOptions options;
+	options.minThreads = 1;
+	options.maxThreads = 2;
+	options.queueDepthThreshold = 1000;//Never reached, only the wait time can add a worker
+	options.waitTimeThreshold = std::chrono::milliseconds(20);
+	mt::ThreadPool pool(options);
+
+	pool.push([]() { std::this_thread::sleep_for(std::chrono::milliseconds(200)); });
+	for (int i = 0; i < 10 && pool.numThreads() < 2; i++)
+	{
+		pool.push([this]() { taskExecutionCounter++; });
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	ASSERT_EQ(2, pool.numThreads());
+	//The second worker gets to the short tasks while the first one is still busy with the long one
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+	while (!taskExecutionCounter && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ASSERT_LT(0, taskExecutionCounter.load());
+}
+
+TEST_F(ThreadPoolTests, ElasticFromZeroThreads)
+{
+	mt::ElasticPoolOptions options;
+	options.minThreads = 0;
+	options.maxThreads = 2;
+	options.idleTimeout = std::chrono::milliseconds(50);
+	mt::ThreadPool pool(options);
+	ASSERT_EQ(0, pool.numThreads());
+
+	ASSERT_EQ(42, pool.submit([]() { return 42; }).get());
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (pool.numThreads() && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	ASSERT_EQ(0, pool.numThreads());
+
+	//A pool that has shrunk to nothing still takes tasks
+	ASSERT_EQ(43, pool.submit([]() { return 43; }).get());
+}
+
+TEST_F(ThreadPoolTests, ElasticKillProcessesPendingTasks)
+{
+	mt::ElasticPoolOptions options;
+	options.minThreads = 1;
+	options.maxThreads = 4;
+	options.queueDepthThreshold = 10;
+	mtInternal::ElasticPool pool(options, mt::ThreadOptions());
+
+	std::vector<Task> tasks;
+	for (int i = 0; i < totalTasks; i++)
+		tasks.emplace_back([this]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); taskExecutionCounter++; });
+
+	pool.push_bulk(tasks.begin(), tasks.end());
+	ASSERT_LE(pool.peakThreads(), options.maxThreads);
+	pool.kill();
+	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
+	ASSERT_THROW(pool.push([]() {}), std::runtime_error);
+
+	options.minThreads = 5;
+	ASSERT_THROW(mt::ThreadPool{ options }, std::invalid_argument);
+	options.minThreads = options.maxThreads = 0;
+	ASSERT_THROW(mt::ThreadPool{ options }, std::invalid_argument);
+}
+
 TEST_F(ThreadPoolTests, DISABLED_TestKillByDestruction)
 {
 	{
@@ -0,0 +1,170 @@
+#include <ThreadPool.hpp>
+#include <TaskScheduler.hpp>
+#include <TaskThrottlers.hpp>
+#include <gtest/gtest.h>
+#include <future>
+#include <set>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace ULMTTools;
+
+namespace
+{
+	std::string currentThreadName()
+	{
+		char name[16] = {};
+		pthread_getname_np(pthread_self(), name, sizeof(name));
+		return name;
+	}
+
+	std::set<int> currentThreadCores()
+	{
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+
+		std::set<int> cores;
+		for (int i = 0; i < CPU_SETSIZE; i++)
+			if (CPU_ISSET(i, &cpuSet))
+				cores.insert(i);
+		return cores;
+	}
+
+	size_t currentThreadStackSize()
+	{
+		pthread_attr_t attr;
+		size_t stackSize = 0;
+		pthread_getattr_np(pthread_self(), &attr);
+		pthread_attr_getstacksize(&attr, &stackSize);
+		pthread_attr_destroy(&attr);
+		return stackSize;
+	}
+
+	//Runs 'func' on the worker and returns its result
+	template <class F>
+	auto runOn(WorkerThread& worker, F func)
+	{
+		std::promise<decltype(func())> promise;
+		auto future = promise.get_future();
+		worker.push([&promise, &func]() { promise.set_value(func()); });
+		return future.get();
+	}
+}
+
+TEST(ThreadTests, WorkerIsNamedPinnedAndGetsItsStack)
+{
+	ThreadOptions options;
+	options.name = "mttools-worker-with-a-long-name";
+	options.cores = { 0 };
+	options.stackSize = 4 * 1024 * 1024;
+
+	WorkerThread worker(options);
+	ASSERT_EQ(std::string("mttools-worker-"), runOn(worker, currentThreadName));//Truncated to 15 characters
+	ASSERT_EQ(std::set<int>{ 0 }, runOn(worker, currentThreadCores));
+	ASSERT_GE(runOn(worker, currentThreadStackSize), options.stackSize);
+}
+
+TEST(ThreadTests, NiceValueIsApplied)
+{
+	ThreadOptions options;
+	options.priority = 5;//Raising the nice value needs no privileges
+
+	WorkerThread worker(options);
+	int nice = runOn(worker, []() { return getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid))); });
+	ASSERT_EQ(5, nice);
+}
+
+TEST(ThreadTests, RealTimePolicyIsAppliedOrRefused)
+{
+	ThreadOptions options;
+	options.schedulingPolicy = SchedulingPolicy::Fifo;
+	options.priority = 1;
+
+	try
+	{
+		WorkerThread worker(options);
+		int policy = runOn(worker, []()
+			{
+				int policy = 0;
+				sched_param param;
+				pthread_getschedparam(pthread_self(), &policy, &param);
+				return policy;
+			});
+		ASSERT_EQ(SCHED_FIFO, policy);
+	}
+	catch (const std::system_error& err)
+	{
+		//Not permitted without CAP_SYS_NICE, the failure must surface right away instead of silently running as SCHED_OTHER
+		ASSERT_EQ(EPERM, err.code().value());
+	}
+}
+
+TEST(ThreadTests, PoolAppliesCoreMapAndNumbersWorkers)
+{
+	const size_t numThreads = 4;
+	ThreadOptions options;
+	options.name = "pool";
+	options.cores = { 0 };
+
+	ThreadPool pool(numThreads, options);
+	std::mutex mutex;
+	std::set<std::string> names;
+	std::set<int> cores;
+	std::vector<std::promise<void>> done(numThreads);
+	for (size_t i = 0; i < numThreads; i++)
+		pool.push([&, i]()
+			{
+				{
+					stdUniqueLock lock(mutex);
+					names.insert(currentThreadName());
+					auto currCores = currentThreadCores();
+					cores.insert(currCores.begin(), currCores.end());
+				}
+				done[i].set_value();
+			});
+
+	for (auto& promise : done)
+		promise.get_future().wait();
+
+	ASSERT_EQ((std::set<std::string>{ "pool-0", "pool-1", "pool-2", "pool-3" }), names);
+	ASSERT_EQ(std::set<int>{ 0 }, cores);
+}
+
+TEST(ThreadTests, SchedulerAndThrottlerAcceptOptions)
+{
+	ThreadOptions options;
+	options.name = "timed";
+
+	std::promise<std::string> schedulerName;
+	TaskScheduler scheduler(options);
+	scheduler.push(ULCommonUtils::now(), [&]() { schedulerName.set_value(currentThreadName()); });
+	ASSERT_EQ("timed", schedulerName.get_future().get());
+
+	options.name = "throttled";
+	std::promise<std::string> throttlerName;
+	ThrottledWorkerThread throttler(std::chrono::milliseconds(10), 1, options);
+	throttler.push([&]() { throttlerName.set_value(currentThreadName()); });
+	ASSERT_EQ("throttled", throttlerName.get_future().get());
+	throttler.kill();
+}
+
+TEST(ThreadTests, InvalidCoreIsRefused)
+{
+	ThreadOptions options;
+	options.cores = { CPU_SETSIZE - 1 };
+	ASSERT_THROW(WorkerThread worker(options), std::system_error);
+
+	//Not even a CPU number
+	options.cores = { -1 };
+	ASSERT_THROW(WorkerThread worker(options), std::invalid_argument);
+	options.cores = { 0, CPU_SETSIZE };
+	ASSERT_THROW(WorkerThread worker(options), std::invalid_argument);
+}
+#endif
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <TaskThrottlers.hpp>
 #include <chrono>
+#include <algorithm>
 #include <CommonUtils/CommonDefs.hpp>
 #include <gtest/gtest.h>
 
@@ -97,6 +98,102 @@ TEST_F(ThrottlingTests, SingleThreaded)
 	}
 }
 
+TEST_F(ThrottlingTests, PushBulk)
+{
+	mt::ThrottledWorkerThread throttler(unitTime, numTasksPerUnitTime);
+	mtInternal::ConditionVariable cond;
+
+	std::vector<Task> tasks;
+	for (int i = 1; i <= totalTasks; i++)
+	{
+		tasks.emplace_back([this, &cond]()
+		{
+			taskExecutionTimestamps.push_back(ULCommonUtils::now());
+			if (totalTasks == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	throttler.push_bulk(tasks.begin(), tasks.end());
+	cond.wait();
+	ASSERT_EQ(taskExecutionCounter, totalTasks);
+
+	ASSERT_EQ(taskExecutionTimestamps.size(), totalTasks);
+
+	//Every task of the batch is still throttled individually
+	for (auto [timeWindowStart, timeWindowEnd, startIndex, endIndex] = std::tuple{taskExecutionTimestamps[0],taskExecutionTimestamps[0] + unitTime, size_t{0}, size_t{1}};
+		 endIndex <= taskExecutionTimestamps.size();
+		 endIndex++
+		)
+	{
+		if (endIndex == taskExecutionTimestamps.size())
+		{
+			ASSERT_EQ(endIndex - startIndex, numTasksPerUnitTime);
+			ASSERT_LE(taskExecutionTimestamps[endIndex - 1] - taskExecutionTimestamps[startIndex], unitTime);
+		}
+		else if (taskExecutionTimestamps[endIndex] >= timeWindowEnd)
+		{
+			ASSERT_EQ(endIndex - startIndex, numTasksPerUnitTime);
+			ASSERT_LE(taskExecutionTimestamps[endIndex - 1] - taskExecutionTimestamps[startIndex], unitTime);
+			timeWindowStart += unitTime;
+			timeWindowEnd = timeWindowStart + unitTime;
+			startIndex = endIndex;
+		}
+	}
+}
+
+TEST_F(ThrottlingTests, EnqueueToExecuteLatencyPerWaitStrategy)
+{
+	const size_t numSamples = 2000;
+	auto gapBetweenPushes = std::chrono::microseconds(100);
+
+	for (auto strategy : { mt::WaitStrategy::Blocking, mt::WaitStrategy::SpinThenPark, mt::WaitStrategy::BusyPoll })
+	{
+		std::vector<int64_t> latencies;
+		latencies.reserve(numSamples);
+		{
+			//Bandwidth high enough for the throttling never to kick in, only the idle wait is measured
+			mt::ThrottledWorkerThread throttler(unitTime, numSamples * 2, strategy);
+			for (size_t i = 0; i < numSamples; i++)
+			{
+				std::this_thread::sleep_for(gapBetweenPushes);
+				throttler.push([&latencies, pushTime = std::chrono::steady_clock::now()]()
+				{
+					latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - pushTime).count());
+				});
+			}
+		}
+
+		ASSERT_EQ(numSamples, latencies.size());
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&latencies](double p) { return latencies[(size_t)(p * (latencies.size() - 1))]; };
+		std::cout << "Enqueue to execute latency(ns), "
+			<< (mt::WaitStrategy::Blocking == strategy ? "blocking" : mt::WaitStrategy::SpinThenPark == strategy ? "spin then park" : "busy poll")
+			<< ": p50 = " << percentile(0.5) << ", p99 = " << percentile(0.99) << ", p99.9 = " << percentile(0.999) << std::endl;
+	}
+}
+
+TEST_F(ThrottlingTests, BusyPollStillThrottles)
+{
+	mt::ThrottledWorkerThread throttler(unitTime / 10, numTasksPerUnitTime / 10, mt::WaitStrategy::BusyPoll);
+	mtInternal::ConditionVariable cond;
+	int numTasks = static_cast<int>(numTasksPerUnitTime / 5);
+
+	auto start = ULCommonUtils::now();
+	for (int i = 1; i <= numTasks; i++)
+	{
+		throttler.push([this, &cond, numTasks]()
+		{
+			if (numTasks == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	//2 windows worth of tasks need at least one full window to elapse
+	ASSERT_GE(ULCommonUtils::now() - start, unitTime / 10);
+}
+
 TEST_F(ThrottlingTests, TestPushingTasksFromMultipleThreads)
 {
 	mt::ThrottledWorkerThread throttler(unitTime, numTasksPerUnitTime);
@@ -348,6 +445,272 @@ TEST_F(ReusableThrottlerTests, TestPushingTasksFromMultipleThreads)
 	}
 }
 
+TEST_F(ReusableThrottlerTests, TasksAreMovedNotCopied)
+{
+	//Counts how many times the payload has been copied on its way to the throttlers' threads
+	struct CopyCounter
+	{
+		std::atomic<int>* m_numCopies;
+
+		CopyCounter(std::atomic<int>* numCopies) : m_numCopies(numCopies) {}
+		CopyCounter(CopyCounter&&) = default;
+		CopyCounter(const CopyCounter& other) : m_numCopies(other.m_numCopies) { (*m_numCopies)++; }
+	};
+
+	std::atomic<int> numCopies = 0;
+	std::atomic<size_t> numExecuted = 0;
+	mtInternal::ConditionVariable cond;
+	size_t numTasks = bandwidth1 / 10;
+
+	auto worker = std::make_shared<mt::WorkerThread>();
+	auto scheduler = std::make_shared<mt::TaskScheduler>();
+	mt::ReusableThrottledWorkerThread reusableThrottler(worker, scheduler, unitTime, bandwidth1);
+	mt::ThrottledWorkerThread throttler(unitTime, bandwidth1);
+
+	for (size_t i = 1; i <= numTasks; i++)
+	{
+		auto func = [&numExecuted, &cond, numTasks, payload = CopyCounter(&numCopies)]()
+		{
+			if (2 * numTasks == ++numExecuted)
+				cond.notify_one();
+		};
+
+		reusableThrottler.push([func = std::move(func)]() mutable { func(); });
+		throttler.emplace([&numExecuted, &cond, numTasks, payload = CopyCounter(&numCopies)]()
+		{
+			if (2 * numTasks == ++numExecuted)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	ASSERT_EQ(2 * numTasks, numExecuted.load());
+	ASSERT_EQ(0, numCopies.load());
+}
+
+TEST(RateLimiterTests, TokenBucketKeepsToTheWindows)
+{
+	//A sender taking every transaction as soon as the limiter allows it, on a simulated clock
+	auto send = [](const mt::RateLimit& limit, size_t numTransactions)
+	{
+		mtInternal::RateLimiter limiter(limit);
+		std::vector<time_point> timestamps;
+		time_point now = ULCommonUtils::now();
+		for (size_t i = 0; i < numTransactions; i++)
+		{
+			now = limiter.availableAt(now);
+			limiter.record(now);
+			timestamps.push_back(now);
+		}
+		return timestamps;
+	};
+
+	//Evenly spaced, exactly numTransactions in every window as with the sliding window
+	duration unitTime = std::chrono::seconds(1);
+	size_t numTasksPerUnitTime = 1000;
+	for (auto mode : { mt::ThrottlingMode::SlidingWindow, mt::ThrottlingMode::TokenBucket })
+	{
+		auto taskExecutionTimestamps = send(mt::RateLimit(unitTime, numTasksPerUnitTime, mode), numTasksPerUnitTime * 10);
+		for (auto [timeWindowStart, timeWindowEnd, startIndex, endIndex] = std::tuple{taskExecutionTimestamps[0],taskExecutionTimestamps[0] + unitTime, size_t{0}, size_t{1}};
+			 endIndex <= taskExecutionTimestamps.size();
+			 endIndex++
+			)
+		{
+			if (endIndex == taskExecutionTimestamps.size())
+			{
+				ASSERT_EQ(endIndex - startIndex, numTasksPerUnitTime);
+				ASSERT_LE(taskExecutionTimestamps[endIndex - 1] - taskExecutionTimestamps[startIndex], unitTime);
+			}
+			else if (taskExecutionTimestamps[endIndex] >= timeWindowEnd)
+			{
+				ASSERT_EQ(endIndex - startIndex, numTasksPerUnitTime);
+				ASSERT_LE(taskExecutionTimestamps[endIndex - 1] - taskExecutionTimestamps[startIndex], unitTime);
+				timeWindowStart += unitTime;
+				timeWindowEnd = timeWindowStart + unitTime;
+				startIndex = endIndex;
+			}
+		}
+	}
+
+	//1M/sec with a burst of 100: the burst goes at once, then one per microsecond, never more than
+	//numTransactions + burst - 1 in any window
+	size_t burst = 100;
+	unitTime = std::chrono::milliseconds(1);
+	auto timestamps = send(mt::RateLimit(unitTime, numTasksPerUnitTime, mt::ThrottlingMode::TokenBucket, burst), numTasksPerUnitTime * 10);
+	ASSERT_EQ(timestamps[0], timestamps[burst - 1]);
+	ASSERT_GT(timestamps[burst], timestamps[0]);
+	for (size_t i = 0; i + numTasksPerUnitTime + burst - 1 < timestamps.size(); i++)
+		ASSERT_GE(timestamps[i + numTasksPerUnitTime + burst - 1] - timestamps[i], unitTime);
+	ASSERT_EQ(timestamps.back() - timestamps[burst - 1], std::chrono::microseconds(1) * static_cast<int>(timestamps.size() - burst));
+
+	ASSERT_THROW(mtInternal::RateLimiter(mt::RateLimit(unitTime, 0)), std::invalid_argument);
+	ASSERT_THROW(mtInternal::RateLimiter(mt::RateLimit(unitTime, 1, mt::ThrottlingMode::TokenBucket, 0)), std::invalid_argument);
+}
+
+TEST(RateLimiterTests, SlidingWindowBoundary)
+{
+	//2 per 10ms, the third transaction goes exactly a unit time after the first one, not a tick later
+	mtInternal::RateLimiter limiter(mt::RateLimit(std::chrono::milliseconds(10), 2));
+	time_point start = ULCommonUtils::now();
+	limiter.record(start);
+	limiter.record(start + std::chrono::milliseconds(1));
+	ASSERT_EQ(start + std::chrono::milliseconds(10), limiter.availableAt(start + std::chrono::milliseconds(9)));
+	ASSERT_EQ(start + std::chrono::milliseconds(10), limiter.availableAt(start + std::chrono::milliseconds(10) - std::chrono::nanoseconds(1)));
+	ASSERT_EQ(start + std::chrono::milliseconds(10), limiter.availableAt(start + std::chrono::milliseconds(10)));
+
+	//Once it has gone the window slides on to the second one
+	limiter.record(start + std::chrono::milliseconds(10));
+	ASSERT_EQ(start + std::chrono::milliseconds(11), limiter.availableAt(start + std::chrono::milliseconds(10)));
+	ASSERT_EQ(start + std::chrono::milliseconds(12), limiter.availableAt(start + std::chrono::milliseconds(12)));
+}
+
+TEST_F(ThrottlingTests, TokenBucket)
+{
+	size_t burst = 100;
+	totalTasks = numTasksPerUnitTime * 3;
+	mt::ThrottledWorkerThread throttler(mt::RateLimit(unitTime, numTasksPerUnitTime, mt::ThrottlingMode::TokenBucket, burst));
+	mtInternal::ConditionVariable cond;
+
+	auto start = ULCommonUtils::now();
+	for (int i = 1; i <= totalTasks; i++)
+	{
+		throttler.push([this, &cond]()
+		{
+			taskExecutionTimestamps.push_back(ULCommonUtils::now());
+			if (totalTasks == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	ASSERT_EQ(taskExecutionTimestamps.size(), totalTasks);
+	//The burst right away, the rest at the rate, allowing for the hiccups of the machine
+	auto tolerance = unitTime / 20;
+	ASSERT_LT(taskExecutionTimestamps[burst - 1] - start, tolerance);
+	auto emissionInterval = unitTime / numTasksPerUnitTime;
+	ASSERT_GE(taskExecutionTimestamps.back() - taskExecutionTimestamps[0], emissionInterval * static_cast<int>(totalTasks - burst) - tolerance);
+	ASSERT_LT(taskExecutionTimestamps.back() - taskExecutionTimestamps[0], emissionInterval * totalTasks + tolerance);
+	for (size_t i = 0; i + numTasksPerUnitTime + burst - 1 < taskExecutionTimestamps.size(); i++)
+		ASSERT_GE(taskExecutionTimestamps[i + numTasksPerUnitTime + burst - 1] - taskExecutionTimestamps[i], unitTime - tolerance);
+	ASSERT_THROW(mt::ThrottledWorkerThread(mt::RateLimit(unitTime, 0)), std::invalid_argument);
+}
+
+TEST_F(ReusableThrottlerTests, TokenBucket)
+{
+	size_t burst = 50;
+	auto worker = std::make_shared<mt::WorkerThread>();
+	auto scheduler = std::make_shared<mt::TaskScheduler>();
+	mt::ReusableThrottledWorkerThread throttler(worker, scheduler, mt::RateLimit(unitTime, bandwidth1, mt::ThrottlingMode::TokenBucket, burst));
+	mtInternal::ConditionVariable cond;
+
+	auto start = ULCommonUtils::now();
+	for (size_t i = 1; i <= bandwidth1; i++)
+	{
+		throttler.push([this, &cond]()
+		{
+			taskExecutionTimestamps1.push_back(ULCommonUtils::now());
+			if (bandwidth1 == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	ASSERT_EQ(taskExecutionTimestamps1.size(), bandwidth1);
+	auto tolerance = unitTime / 20;
+	ASSERT_LT(taskExecutionTimestamps1[burst - 1] - start, tolerance);
+	auto emissionInterval = unitTime / bandwidth1;
+	ASSERT_GE(taskExecutionTimestamps1.back() - taskExecutionTimestamps1[0], emissionInterval * static_cast<int>(bandwidth1 - burst) - tolerance);
+	ASSERT_LT(taskExecutionTimestamps1.back() - taskExecutionTimestamps1[0], emissionInterval * static_cast<int>(bandwidth1) + tolerance);
+}
+
+TEST(RateLimiterTests, MultipleWindows)
+{
+	//5 per 10ms and 20 per 100ms(as a token bucket with a burst of 10) at once, taken as soon as the limiter allows
+	std::vector<mt::RateLimit> limits{ mt::RateLimit(std::chrono::milliseconds(10), 5),
+		mt::RateLimit(std::chrono::milliseconds(100), 20, mt::ThrottlingMode::TokenBucket, 10) };
+	mtInternal::RateLimiter limiter(limits);
+	std::vector<time_point> timestamps;
+	time_point now = ULCommonUtils::now();
+	for (size_t i = 0; i < 200; i++)
+	{
+		now = limiter.availableAt(now);
+		limiter.record(now);
+		timestamps.push_back(now);
+	}
+
+	//The burst of 10 is cut in 2 by the 10ms window, which never holds the transactions back for longer than the token
+	//bucket does overall, the 200th going at the bucket's 10 + 950ms / 5ms
+	ASSERT_EQ(timestamps[0], timestamps[4]);
+	ASSERT_EQ(timestamps[5], timestamps[9]);
+	ASSERT_EQ(std::chrono::milliseconds(10), timestamps[5] - timestamps[0]);
+	for (size_t i = 0; i + 5 < timestamps.size(); i++)
+		ASSERT_GE(timestamps[i + 5] - timestamps[i], std::chrono::milliseconds(10));
+	for (size_t i = 0; i + 29 < timestamps.size(); i++)
+		ASSERT_GE(timestamps[i + 29] - timestamps[i], std::chrono::milliseconds(100));
+	ASSERT_EQ(timestamps.back() - timestamps[0], std::chrono::milliseconds(950));
+
+	ASSERT_THROW(mtInternal::RateLimiter(std::vector<mt::RateLimit>()), std::invalid_argument);
+}
+
+TEST_F(ThrottlingTests, MultipleWindows)
+{
+	//20 per 100ms and 60 per 500ms: bursts of 20 at 0, 100 and 200ms, the next ones waiting for the 500ms window
+	//to be rid of the previous ones, at 500, 600, 700, 1000, 1100 and 1200ms
+	std::vector<mt::RateLimit> limits{ mt::RateLimit(unitTime / 10, 20), mt::RateLimit(unitTime / 2, 60) };
+	totalTasks = 180;
+	mt::ThrottledWorkerThread throttler(limits);
+	mtInternal::ConditionVariable cond;
+
+	for (int i = 1; i <= totalTasks; i++)
+	{
+		throttler.push([this, &cond]()
+		{
+			taskExecutionTimestamps.push_back(ULCommonUtils::now());
+			if (totalTasks == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	ASSERT_EQ(taskExecutionTimestamps.size(), totalTasks);
+	//Allowing for the hiccups of the machine between the throttler recording a task and the task reading the clock
+	auto tolerance = unitTime / 40;
+	for (size_t i = 0; i + 20 < taskExecutionTimestamps.size(); i++)
+		ASSERT_GE(taskExecutionTimestamps[i + 20] - taskExecutionTimestamps[i], unitTime / 10 - tolerance);
+	for (size_t i = 0; i + 60 < taskExecutionTimestamps.size(); i++)
+		ASSERT_GE(taskExecutionTimestamps[i + 60] - taskExecutionTimestamps[i], unitTime / 2 - tolerance);
+	ASSERT_LT(taskExecutionTimestamps.back() - taskExecutionTimestamps[0], unitTime + unitTime / 5 + tolerance);
+}
+
+TEST_F(ReusableThrottlerTests, MultipleWindows)
+{
+	std::vector<mt::RateLimit> limits{ mt::RateLimit(unitTime / 10, 20), mt::RateLimit(unitTime / 2, 60) };
+	size_t numTasks = 180;
+	auto worker = std::make_shared<mt::WorkerThread>();
+	auto scheduler = std::make_shared<mt::TaskScheduler>();
+	mt::ReusableThrottledWorkerThread throttler(worker, scheduler, limits);
+	mtInternal::ConditionVariable cond;
+
+	for (size_t i = 1; i <= numTasks; i++)
+	{
+		throttler.push([this, &cond, numTasks]()
+		{
+			taskExecutionTimestamps1.push_back(ULCommonUtils::now());
+			if (numTasks == ++taskExecutionCounter)
+				cond.notify_one();
+		});
+	}
+
+	cond.wait();
+	ASSERT_EQ(taskExecutionTimestamps1.size(), numTasks);
+	auto tolerance = unitTime / 40;
+	for (size_t i = 0; i + 20 < taskExecutionTimestamps1.size(); i++)
+		ASSERT_GE(taskExecutionTimestamps1[i + 20] - taskExecutionTimestamps1[i], unitTime / 10 - tolerance);
+	for (size_t i = 0; i + 60 < taskExecutionTimestamps1.size(); i++)
+		ASSERT_GE(taskExecutionTimestamps1[i + 60] - taskExecutionTimestamps1[i], unitTime / 2 - tolerance);
+	ASSERT_LT(taskExecutionTimestamps1.back() - taskExecutionTimestamps1[0], unitTime + unitTime / 5 + tolerance);
+}
+
 int main(int argc, const char **argv)
 {
 	::testing::InitGoogleTest();
@@ -144,6 +144,210 @@ TEST_F(AdvancedTimerTests, MultipleTimersFromMultipleThreads)
 	ASSERT_EQ(taskExecutionTimestamps3.size(), 15);
 }
 
+TEST_F(BasicTimerTests, UnInstallCancelsThePendingRun)
+{
+	auto scheduler = std::make_shared<mt::TaskScheduler>();
+	mt::Timer timer(scheduler);
+	std::atomic<int> numRuns = 0;
+	auto id = timer.install([&numRuns]() { numRuns++; }, std::chrono::hours(1));
+	//Time for the next run to be scheduled after the first one
+	while (!numRuns)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	//The run due in an hour is cancelled rather than left in the scheduler to find the timer gone
+	timer.unInstall(id);
+	ASSERT_EQ(1, scheduler->numCancelledResident());
+	ASSERT_EQ(1, numRuns.load());
+}
+
+TEST_F(BasicTimerTests, DestructionUnInstallsTheTimers)
+{
+	auto scheduler = std::make_shared<mt::TaskScheduler>();
+	std::atomic<int> numRuns = 0;
+	{
+		mt::Timer timer(scheduler);
+		timer.install([&numRuns]() { numRuns++; }, std::chrono::milliseconds(5));
+		while (numRuns < 3)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	//The scheduler outlives the timer, but the periodic task doesn't, once a run in progress at the destruction is over
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	int numRunsAtDestruction = numRuns;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(numRunsAtDestruction, numRuns.load());
+}
+
+TEST_F(AdvancedTimerTests, SlowCallbackOnAnExecutor)
+{
+	//A callback taking 3 times its interval on a worker of its own, next to a quick timer run by the scheduler thread
+	auto worker = std::make_shared<mt::WorkerThread>();
+	mt::Timer timer(std::make_shared<mt::TaskScheduler>());
+	std::atomic<int> numSlowRuns = 0;
+	auto slowId = timer.install([&numSlowRuns]() { numSlowRuns++; std::this_thread::sleep_for(std::chrono::milliseconds(30)); },
+		std::chrono::milliseconds(10), mt::makeTaskExecutor(worker));
+
+	auto func = [this]()
+	{
+		stdUniqueLock lock(mutex);
+		taskExecutionTimestamps1.push_back(utils::now());
+	};
+	auto quickId = timer.install(func, std::chrono::milliseconds(10));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(505));
+	timer.unInstall(quickId);
+	timer.unInstall(slowId);
+
+	//The quick timer keeps its schedule, and the slow one's runs queue up on the worker rather than being delayed
+	stdUniqueLock lock(mutex);
+	ASSERT_GE(taskExecutionTimestamps1.size(), 50);
+	//Run inline, every 30ms callback would make the quick runs due meanwhile late, allow for the odd hiccup of the machine
+	size_t numLate = 0;
+	for (size_t i = 0; i < taskExecutionTimestamps1.size(); i++)
+		if (taskExecutionTimestamps1[i] - (taskExecutionTimestamps1.front() + std::chrono::milliseconds(10) * static_cast<int>(i)) > std::chrono::milliseconds(5))
+			numLate++;
+	ASSERT_LE(numLate, 3);
+	ASSERT_GE(numSlowRuns.load(), 10);
+	lock.unlock();
+	worker->kill();
+}
+
+TEST_F(BasicTimerTests, SkippedTicksAreCounted)
+{
+	mt::Timer timer(std::make_shared<mt::TaskScheduler>());
+	std::atomic<int> numRuns = 0;
+	mt::PeriodicOptions options;
+	options.overrun = mt::OverrunPolicy::Skip;
+	//The first run overruns the ticks due at 10 and 20ms
+	auto id = timer.install([&numRuns]() { if (1 == ++numRuns) std::this_thread::sleep_for(std::chrono::milliseconds(25)); },
+		std::chrono::milliseconds(10), options);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	ASSERT_GE(timer.numMissedTicks(id), 2);
+	timer.unInstall(id);
+	ASSERT_EQ(0, timer.numMissedTicks(id));
+	ASSERT_LE(numRuns.load(), 9);
+
+	//The runs on an executor end out of the scheduler's sight
+	ASSERT_THROW(timer.install([]() {}, std::chrono::milliseconds(10), options, mt::makeTaskExecutor(std::make_shared<mt::WorkerThread>())),
+		std::invalid_argument);
+}
+
+TEST_F(BasicTimerTests, InitialDelayAndPhase)
+{
+	mt::Timer timer(std::make_shared<mt::TaskScheduler>());
+	std::vector<duration> firstRuns(4);
+	std::atomic<int> numFirstRuns = 0;
+	auto start = utils::now();
+	auto firstRun = [&](size_t idx)
+	{
+		return [&, idx, ran = false]() mutable
+		{
+			if (ran)
+				return;
+			ran = true;
+			firstRuns[idx] = utils::now() - start;
+			numFirstRuns++;
+		};
+	};
+
+	mt::TimerOptions options;
+	options.initialDelay = std::chrono::milliseconds(50);
+	timer.install(firstRun(0), std::chrono::milliseconds(100), options);
+	//Spread over the interval: at 0 then 61.8ms, 23.6ms(0.236 = 2 * 0.618 - 1), ... of it
+	options.initialDelay = duration::zero();
+	options.phase = mt::TimerPhase::Spread;
+	for (size_t i = 1; i < firstRuns.size(); i++)
+		timer.install(firstRun(i), std::chrono::milliseconds(100), options);
+
+	while (numFirstRuns < static_cast<int>(firstRuns.size()))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	ASSERT_GE(firstRuns[0], std::chrono::milliseconds(50));
+	ASSERT_LT(firstRuns[1], std::chrono::milliseconds(10));
+	ASSERT_GE(firstRuns[2], std::chrono::milliseconds(61));
+	ASSERT_GE(firstRuns[3], std::chrono::milliseconds(23));
+	ASSERT_LT(firstRuns[3], firstRuns[0]);
+}
+
+TEST(TimerBenchmark, PhaseSpreading)
+{
+	//20k heartbeats of a 1s period installed at once, the peak of timers fired by one wakeup of the scheduler thread
+	const size_t numTimers = 20000;
+	auto peakPerWakeup = [numTimers](mt::TimerPhase phase, const duration& jitter)
+	{
+		mt::SchedulerOptions schedulerOptions;
+		schedulerOptions.backend = mt::TimerBackend::TimingWheel;
+		auto scheduler = std::make_shared<mt::TaskScheduler>(schedulerOptions);
+		mt::Timer timer(scheduler);
+		mt::TimerOptions options;
+		options.phase = phase;
+		options.jitter = jitter;
+		std::atomic<size_t> numRuns = 0;
+		std::vector<size_t> ids;
+		for (size_t i = 0; i < numTimers; i++)
+			ids.push_back(timer.install([&numRuns]() { numRuns.fetch_add(1, std::memory_order_relaxed); }, std::chrono::seconds(1), options));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+		auto stats = scheduler->stats();
+		for (size_t id : ids)
+			timer.unInstall(id);
+		EXPECT_GE(numRuns.load(), 2 * numTimers);
+		return stats;
+	};
+
+	auto aligned = peakPerWakeup(mt::TimerPhase::Aligned, duration::zero());
+	auto spread = peakPerWakeup(mt::TimerPhase::Spread, duration::zero());
+	auto random = peakPerWakeup(mt::TimerPhase::Random, std::chrono::milliseconds(10));
+	for (auto [name, stats] : { std::make_pair("aligned", aligned), std::make_pair("spread", spread), std::make_pair("random + 10ms jitter", random) })
+		std::cout << numTimers << " timers, " << name << ": " << stats.maxFiredPerWakeup << " fired by the busiest wakeup, "
+			<< stats.numFired << " in " << stats.numFiringWakeups << " wakeups" << std::endl;
+	ASSERT_LT(spread.maxFiredPerWakeup * 5, aligned.maxFiredPerWakeup);
+	ASSERT_LT(random.maxFiredPerWakeup * 5, aligned.maxFiredPerWakeup);
+}
+
+TEST(TimerBenchmark, MillionTimers)
+{
+	//1M timers of a 1s period, installed from 4 threads, run for 3 periods and uninstalled
+	const size_t numTimers = 1000000;
+	const size_t numThreads = 4;
+	mt::SchedulerOptions options;
+	options.backend = mt::TimerBackend::TimingWheel;
+	auto scheduler = std::make_shared<mt::TaskScheduler>(options);
+	mt::Timer timer(scheduler);
+	std::atomic<size_t> numRuns = 0;
+	std::vector<size_t> ids(numTimers);
+	auto ns = [](auto d) { return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()); };
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> installers;
+	for (size_t t = 0; t < numThreads; t++)
+		installers.emplace_back([&, t]()
+			{
+				for (size_t i = t; i < numTimers; i += numThreads)
+					ids[i] = timer.install([&numRuns]() { numRuns.fetch_add(1, std::memory_order_relaxed); }, std::chrono::seconds(1));
+			});
+	for (auto& installer : installers)
+		installer.join();
+	auto installed = std::chrono::steady_clock::now();
+
+	std::this_thread::sleep_for(std::chrono::seconds(3));
+	size_t numRunsBeforeUninstall = numRuns.load();
+	auto stats = scheduler->stats();
+
+	auto uninstallStart = std::chrono::steady_clock::now();
+	for (size_t id : ids)
+		timer.unInstall(id);
+	auto uninstalled = std::chrono::steady_clock::now();
+
+	//Every timer ran at least on installation and on the next 2 periods
+	ASSERT_GE(numRunsBeforeUninstall, 3 * numTimers);
+	std::cout << numTimers << " timers: " << ns(installed - start) / numTimers << "ns per install(" << numThreads << " threads), "
+		<< ns(uninstalled - uninstallStart) / numTimers << "ns per uninstall, " << numRunsBeforeUninstall << " runs in "
+		<< stats.numFiringWakeups << " wakeups over 3s" << std::endl;
+}
+
 int main(int argc, const char **argv)
 {
 	::testing::InitGoogleTest();
@@ -1,9 +1,32 @@
 #include <WorkerThread.hpp>
+#include <algorithm>
 #include <gtest/gtest.h>
 
 namespace mt = ULMTTools;
 namespace mtInternal = mtInternalUtils;
 
+//Counts how many times an instance has been copied, used to verify that items are only ever moved on their way to the consumer
+struct CopyCounter
+{
+	static std::atomic<int> numCopies;
+
+	CopyCounter() = default;
+	CopyCounter(CopyCounter&&) = default;
+	CopyCounter& operator=(CopyCounter&&) = default;
+
+	CopyCounter(const CopyCounter&)
+	{
+		numCopies++;
+	}
+
+	CopyCounter& operator=(const CopyCounter&)
+	{
+		numCopies++;
+		return *this;
+	}
+};
+std::atomic<int> CopyCounter::numCopies = 0;
+
 struct WorkerThreadTests : ::testing::Test 
 {
 	int totalTasks;
@@ -74,6 +97,451 @@ TEST_F(WorkerThreadTests, TestPushingTasksFromMultipleThreads)
 	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
 }
 
+TEST_F(WorkerThreadTests, TestLockFreeBackendPreservesPerProducerOrder)
+{
+	mt::WorkerThread worker(mt::QueueBackend::LockFree);
+	mtInternal::ConditionVariable cond;
+	const int numProducers = 4;
+	int lastSeen[numProducers] = { -1, -1, -1, -1 };
+	std::atomic<bool> inOrder = true;
+
+	std::thread threads[numProducers];
+	for (int j = 0; j < numProducers; j++)
+	{
+		threads[j] = std::thread([this, j, &worker, &lastSeen, &inOrder, &cond]() {
+			for (int i = 0; i < totalTasks; i++)
+			{
+				worker.push([this, i, j, &lastSeen, &inOrder, &cond]()
+				{
+					//All tasks run on the same thread, so lastSeen needs no synchronization
+					if (lastSeen[j] + 1 != i)
+						inOrder = false;
+					lastSeen[j] = i;
+					if (totalTasks * numProducers == ++taskExecutionCounter)
+						cond.notify_one();
+				});
+			}
+		});
+	}
+
+	for (int i = 0; i < numProducers; i++)
+		threads[i].join();
+
+	cond.wait();
+	ASSERT_EQ(totalTasks * numProducers, taskExecutionCounter.load());
+	ASSERT_TRUE(inOrder.load());
+}
+
+TEST_F(WorkerThreadTests, TestLockFreeBackendDrainsOnKill)
+{
+	{
+		mt::WorkerThread worker(mt::QueueBackend::LockFree);
+		for (int i = 1; i <= totalTasks; i++)
+			worker.push([this]() { taskExecutionCounter++; });
+	}
+	//The destructor should have blocked until all the pending items were processed
+	ASSERT_EQ(taskExecutionCounter.load(), totalTasks);
+}
+
+TEST(MPSCQueueTests, ThrowsLeaveTheQueueUsable)
+{
+	mtInternal::MPSCQueue<std::shared_ptr<int>> queue;
+	auto item = std::make_shared<int>(0);
+	for (int i = 0; i < 3; i++)
+		queue.push(item);
+
+	//The item given to the throwing processor is destroyed all the same
+	ASSERT_THROW(queue.consume([](std::shared_ptr<int>&) { throw std::runtime_error("processor"); }), std::runtime_error);
+	ASSERT_EQ(3, item.use_count());
+
+	size_t numConsumed = queue.consume([](std::shared_ptr<int>& p) { ++*p; });
+	ASSERT_EQ(2, numConsumed);
+	ASSERT_EQ(2, *item);
+	ASSERT_EQ(1, item.use_count());
+	ASSERT_TRUE(queue.empty());
+
+	//A move throwing in the middle of a range queues none of it, the items moved so far being destroyed
+	struct ThrowingMove
+	{
+		std::shared_ptr<int> m_payload;
+		bool m_throwOnMove;
+
+		ThrowingMove(std::shared_ptr<int> payload, bool throwOnMove) : m_payload(std::move(payload)), m_throwOnMove(throwOnMove)
+		{
+		}
+
+		ThrowingMove(ThrowingMove&& other) : m_payload(std::move(other.m_payload)), m_throwOnMove(other.m_throwOnMove)
+		{
+			if (m_throwOnMove)
+				throw std::runtime_error("move");
+		}
+	};
+
+	mtInternal::MPSCQueue<ThrowingMove> rangeQueue;
+	std::vector<ThrowingMove> range;
+	range.reserve(5);
+	for (int i = 0; i < 5; i++)
+		range.emplace_back(item, 3 == i);
+	ASSERT_THROW(rangeQueue.pushRange(range.begin(), range.end()), std::runtime_error);
+	ASSERT_TRUE(rangeQueue.empty());
+	//Only the one never moved out of the range is left
+	ASSERT_EQ(2, item.use_count());
+
+	range.back().m_throwOnMove = false;
+	ASSERT_EQ(1, rangeQueue.pushRange(range.end() - 1, range.end()));
+	ASSERT_EQ(1, rangeQueue.consume([&item](ThrowingMove& moved) { ASSERT_EQ(item, moved.m_payload); }));
+	ASSERT_EQ(1, item.use_count());
+}
+
+TEST_F(WorkerThreadTests, ContentionLockedVsLockFree)
+{
+	const size_t numProducers = 8;
+	const size_t numTasksPerProducer = 100000;
+
+	auto measure = [numProducers, numTasksPerProducer](mt::QueueBackend backend)
+	{
+		std::atomic<size_t> numExecuted = 0;
+		mtInternal::ConditionVariable cond;
+		mt::WorkerThread worker(backend);
+		auto func = [&numExecuted, &cond, numProducers, numTasksPerProducer]()
+		{
+			if (numProducers * numTasksPerProducer == ++numExecuted)
+				cond.notify_one();
+		};
+
+		auto now = std::chrono::high_resolution_clock::now;
+		auto start = now();
+		std::vector<std::thread> producers;
+		for (size_t j = 0; j < numProducers; j++)
+		{
+			producers.emplace_back([&worker, &func, numTasksPerProducer]() {
+				for (size_t i = 0; i < numTasksPerProducer; i++)
+					worker.push(func);
+			});
+		}
+
+		for (auto& producer : producers)
+			producer.join();
+		auto t_push = now() - start;
+
+		cond.wait();
+		auto t_total = now() - start;
+		auto toMicros = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+		return std::pair(toMicros(t_push), toMicros(t_total));
+	};
+
+	auto [t_pushLocked, t_totalLocked] = measure(mt::QueueBackend::LockedVector);
+	auto [t_pushLockFree, t_totalLockFree] = measure(mt::QueueBackend::LockFree);
+	std::cout << numProducers << " producers x " << numTasksPerProducer << " tasks, push phase/end to end: locked vector = "
+		<< t_pushLocked << "us/" << t_totalLocked << "us, lock free = " << t_pushLockFree << "us/" << t_totalLockFree << "us" << std::endl;
+}
+
+TEST_F(WorkerThreadTests, TestTasksAreMovedNotCopied)
+{
+	CopyCounter::numCopies = 0;
+
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		mt::WorkerThread worker(backend);
+		mtInternal::ConditionVariable cond;
+
+		for (int i = 1; i <= totalTasks; i++)
+		{
+			auto func = [this, &cond, payload = CopyCounter()]()
+			{
+				if (totalTasks == ++taskExecutionCounter)
+					cond.notify_one();
+			};
+
+			if (i % 2)
+				worker.push(std::move(func));
+			else
+				worker.emplace(std::move(func));
+		}
+
+		cond.wait();
+		taskExecutionCounter = 0;
+	}
+
+	ASSERT_EQ(0, CopyCounter::numCopies.load());
+}
+
+TEST_F(WorkerThreadTests, TestConsumerOfMoveOnlyItems)
+{
+	mtInternal::ConditionVariable cond;
+	mtInternal::FifoConsumerThread<std::unique_ptr<int>> consumer([this, &cond](std::unique_ptr<int>&& item)
+	{
+		taskExecutionCounter += *item;
+		if (totalTasks == taskExecutionCounter)
+			cond.notify_one();
+	});
+
+	for (int i = 1; i <= totalTasks; i++)
+	{
+		if (i % 2)
+			consumer.push(std::make_unique<int>(1));
+		else
+			consumer.emplace(new int(1));
+	}
+
+	cond.wait();
+	ASSERT_EQ(totalTasks, taskExecutionCounter.load());
+}
+
+TEST_F(WorkerThreadTests, TestPushBulkPreservesOrder)
+{
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		mt::WorkerThread worker(backend);
+		mtInternal::ConditionVariable cond;
+		std::vector<int> executionOrder;
+
+		std::vector<Task> tasks;
+		for (int i = 0; i < totalTasks; i++)
+		{
+			tasks.emplace_back([this, i, &executionOrder, &cond]()
+			{
+				executionOrder.push_back(i);
+				if (totalTasks == ++taskExecutionCounter)
+					cond.notify_one();
+			});
+		}
+
+		worker.push_bulk(tasks.begin(), tasks.begin() + totalTasks / 2);
+		worker.push_bulk(std::span<Task>(tasks).subspan(totalTasks / 2));
+
+		cond.wait();
+		ASSERT_EQ(totalTasks, (int)executionOrder.size());
+		for (int i = 0; i < totalTasks; i++)
+			ASSERT_EQ(i, executionOrder[i]);
+		taskExecutionCounter = 0;
+	}
+}
+
+TEST_F(WorkerThreadTests, PushBulkVsSinglePushes)
+{
+	const size_t burstSize = 500;
+	const size_t numBursts = 200;
+
+	auto measure = [burstSize, numBursts](mt::QueueBackend backend, bool bulk)
+	{
+		std::atomic<size_t> numExecuted = 0;
+		mtInternal::ConditionVariable cond;
+		mt::WorkerThread worker(backend);
+		std::vector<Task> burst;
+		burst.reserve(burstSize);
+
+		auto now = std::chrono::high_resolution_clock::now;
+		auto start = now();
+		for (size_t i = 0; i < numBursts; i++)
+		{
+			for (size_t j = 0; j < burstSize; j++)
+			{
+				burst.emplace_back([&numExecuted, &cond, burstSize, numBursts]()
+				{
+					if (burstSize * numBursts == ++numExecuted)
+						cond.notify_one();
+				});
+			}
+
+			if (bulk)
+				worker.push_bulk(burst.begin(), burst.end());
+			else
+			{
+				for (auto& task : burst)
+					worker.push(std::move(task));
+			}
+			burst.clear();
+		}
+
+		cond.wait();
+		return std::chrono::duration_cast<std::chrono::microseconds>(now() - start).count();
+	};
+
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		auto t_single = measure(backend, false);
+		auto t_bulk = measure(backend, true);
+		std::cout << numBursts << " bursts of " << burstSize << " tasks, "
+			<< (mt::QueueBackend::LockFree == backend ? "lock free" : "locked vector")
+			<< " backend, single pushes: " << t_single << "us, push_bulk: " << t_bulk << "us" << std::endl;
+	}
+}
+
+//Occupies the worker until open() is called, so that the tests can fill up its queue deterministically
+struct Gate
+{
+	mtInternal::ConditionVariable m_entered;
+	mtInternal::ConditionVariable m_opened;
+
+	Task task()
+	{
+		return [this]() { m_entered.notify_one(); m_opened.wait(); };
+	}
+
+	void open()
+	{
+		m_opened.notify_one();
+	}
+};
+
+TEST_F(WorkerThreadTests, TestBoundedRejectAndTryPush)
+{
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		Gate gate;
+		mt::WorkerThread worker(mt::ConsumerOptions{ .backend = backend, .capacity = 4, .overflowPolicy = mt::OverflowPolicy::Reject });
+		worker.push(gate.task());
+		gate.m_entered.wait();
+
+		for (int i = 1; i <= 3; i++)
+			worker.push([this]() { taskExecutionCounter++; });
+
+		ASSERT_THROW(worker.push([this]() { taskExecutionCounter++; }), std::runtime_error);
+		ASSERT_FALSE(worker.try_push([this]() { taskExecutionCounter++; }));
+		ASSERT_EQ(4, worker.size());
+
+		gate.open();
+		worker.kill();
+		ASSERT_EQ(3, taskExecutionCounter.load());
+		taskExecutionCounter = 0;
+	}
+}
+
+TEST_F(WorkerThreadTests, TestBoundedDropPolicies)
+{
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		for (auto policy : { mt::OverflowPolicy::DropNewest, mt::OverflowPolicy::DropOldest })
+		{
+			if (mt::QueueBackend::LockFree == backend && mt::OverflowPolicy::DropOldest == policy)
+				continue;
+
+			Gate gate;
+			std::vector<int> executionOrder;
+			mt::WorkerThread worker(mt::ConsumerOptions{ .backend = backend, .capacity = 4, .overflowPolicy = policy });
+			worker.push(gate.task());
+			gate.m_entered.wait();
+
+			for (int i = 1; i <= 5; i++)
+				worker.push([i, &executionOrder]() { executionOrder.push_back(i); });
+
+			gate.open();
+			worker.kill();
+			ASSERT_EQ(2, worker.numDropped());
+			if (mt::OverflowPolicy::DropNewest == policy)
+				ASSERT_EQ(std::vector<int>({ 1, 2, 3 }), executionOrder);
+			else
+				ASSERT_EQ(std::vector<int>({ 3, 4, 5 }), executionOrder);
+		}
+	}
+}
+
+TEST_F(WorkerThreadTests, TestDropOldestEvictsAtPushTime)
+{
+	//Dropped tasks are gone right away rather than when the consumer gets to them, a stalled consumer holds on to
+	//no more than the capacity
+	Gate gate;
+	const size_t capacity = 4;
+	mt::WorkerThread worker(mt::ConsumerOptions{ .capacity = capacity, .overflowPolicy = mt::OverflowPolicy::DropOldest });
+	worker.push(gate.task());
+	gate.m_entered.wait();
+
+	auto payload = std::make_shared<int>(0);
+	const size_t numPushes = 100000;
+	size_t maxSize = 0;
+	for (size_t i = 0; i < numPushes; i++)
+	{
+		worker.push([payload]() { ++*payload; });
+		maxSize = std::max(maxSize, worker.size());
+	}
+
+	ASSERT_LE(maxSize, capacity);
+	//The gate task takes one of the slots
+	ASSERT_EQ(capacity, static_cast<size_t>(payload.use_count()));
+	ASSERT_EQ(numPushes - (capacity - 1), worker.numDropped());
+
+	gate.open();
+	worker.kill();
+	ASSERT_EQ(static_cast<int>(capacity - 1), *payload);
+	ASSERT_EQ(1, payload.use_count());
+
+	//Only the consumer can take items out of the lock free queue
+	ASSERT_THROW(mt::WorkerThread(mt::ConsumerOptions{ .backend = mt::QueueBackend::LockFree, .capacity = capacity, .overflowPolicy = mt::OverflowPolicy::DropOldest }),
+		std::invalid_argument);
+}
+
+TEST_F(WorkerThreadTests, TestBoundedBlockAndHighWatermark)
+{
+	for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+	{
+		Gate gate;
+		std::vector<size_t> watermarkHits;
+		mt::WorkerThread worker(mt::ConsumerOptions{
+			.backend = backend,
+			.capacity = 4,
+			.overflowPolicy = mt::OverflowPolicy::Block,
+			.highWatermark = 3,
+			.onHighWatermark = [&watermarkHits](size_t numPending) { watermarkHits.push_back(numPending); } });
+		worker.push(gate.task());
+		gate.m_entered.wait();
+
+		for (int i = 1; i <= 3; i++)
+			worker.push([this]() { taskExecutionCounter++; });
+		ASSERT_EQ(std::vector<size_t>({ 3 }), watermarkHits);
+
+		std::atomic<bool> pushed = false;
+		std::thread producer([this, &worker, &pushed]()
+		{
+			worker.push([this]() { taskExecutionCounter++; });
+			pushed = true;
+		});
+
+		std::this_thread::sleep_for(sleepInterval);
+		ASSERT_FALSE(pushed.load());
+
+		gate.open();
+		producer.join();
+		worker.kill();
+		ASSERT_EQ(4, taskExecutionCounter.load());
+		taskExecutionCounter = 0;
+	}
+}
+
+TEST_F(WorkerThreadTests, EnqueueToExecuteLatencyPerWaitStrategy)
+{
+	const size_t numSamples = 2000;
+	auto gapBetweenPushes = std::chrono::microseconds(100);
+
+	for (auto strategy : { mt::WaitStrategy::Blocking, mt::WaitStrategy::SpinThenPark, mt::WaitStrategy::BusyPoll })
+	{
+		for (auto backend : { mt::QueueBackend::LockedVector, mt::QueueBackend::LockFree })
+		{
+			std::vector<int64_t> latencies;
+			latencies.reserve(numSamples);
+			{
+				mt::WorkerThread worker(mt::ConsumerOptions{ .backend = backend, .waitStrategy = strategy });
+				for (size_t i = 0; i < numSamples; i++)
+				{
+					//Gives the worker time to run out of work, so that every sample pays the wait strategy's wakeup cost
+					std::this_thread::sleep_for(gapBetweenPushes);
+					worker.push([&latencies, pushTime = std::chrono::steady_clock::now()]()
+					{
+						latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - pushTime).count());
+					});
+				}
+			}
+
+			ASSERT_EQ(numSamples, latencies.size());
+			std::sort(latencies.begin(), latencies.end());
+			auto percentile = [&latencies](double p) { return latencies[(size_t)(p * (latencies.size() - 1))]; };
+			std::cout << "Enqueue to execute latency(ns), " << (mt::QueueBackend::LockFree == backend ? "lock free" : "locked vector") << " backend, "
+				<< (mt::WaitStrategy::Blocking == strategy ? "blocking" : mt::WaitStrategy::SpinThenPark == strategy ? "spin then park" : "busy poll")
+				<< ": p50 = " << percentile(0.5) << ", p99 = " << percentile(0.99) << ", p99.9 = " << percentile(0.999) << std::endl;
+		}
+	}
+}
+
 TEST_F(WorkerThreadTests, DISABLED_TestKillByDestruction)
 {
 	{
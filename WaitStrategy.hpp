@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include "CommonUtils/CommonDefs.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace mtInternalUtils
+{
+	//How a consumer thread waits when it has nothing to do
+	enum class WaitStrategy
+	{
+		Blocking,//Sleeps right away, cheapest on CPU but pays the wakeup latency of the OS
+		SpinThenPark,//Spins for a while before going to sleep, bursts arriving within the spin window are picked up without a wakeup
+		BusyPoll//Never sleeps, producers never have to wake it up either, meant for threads having a core to themselves
+	};
+
+	//Tells the CPU we are in a spin loop, lowers the power draw and the penalty of leaving the loop
+	inline void cpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+		_mm_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+	//Spins till 'ready' returns true, giving up after 'spinDuration' unless the strategy is BusyPoll
+	//Returns without spinning for WaitStrategy::Blocking, returns the last value of ready()
+	template <class Predicate>
+	bool spinUntil(WaitStrategy strategy, const duration& spinDuration, Predicate&& ready)
+	{
+		if (WaitStrategy::Blocking == strategy)
+			return ready();
+
+		//Reading the clock is far costlier than a pause, so look at it only once in a while
+		const size_t numSpinsPerClockRead = 64;
+		auto spinEnd = std::chrono::steady_clock::now() + spinDuration;
+		for (size_t i = 1; !ready(); i++)
+		{
+			cpuRelax();
+			if (WaitStrategy::BusyPoll != strategy &&
+				0 == i % numSpinsPerClockRead &&
+				std::chrono::steady_clock::now() >= spinEnd)
+				return ready();
+		}
+
+		return true;
+	}
+
+	//Waits till 'deadline' when there is nobody to wake us up earlier, i.e. only time has to pass
+	//SpinThenPark sleeps till 'spinDuration' before the deadline and spins the rest, BusyPoll spins all the way
+	inline void waitUntil(WaitStrategy strategy, const duration& spinDuration, const time_point& deadline)
+	{
+		if (WaitStrategy::Blocking == strategy)
+		{
+			std::this_thread::sleep_until(deadline);
+			return;
+		}
+
+		if (WaitStrategy::SpinThenPark == strategy)
+			std::this_thread::sleep_until(deadline - spinDuration);
+
+		while (ULCommonUtils::now() < deadline)
+			cpuRelax();
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace mtInternalUtils
+{
+	//Chase-Lev work stealing deque(memory orders as in Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models")
+	//The owner thread pushes and pops at the bottom, any other thread may steal from the top
+	//T has to be trivially copyable(typically a pointer) as thieves may read a slot while the owner overwrites it
+	template <class T>
+	class WorkStealingDeque
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque can only hold trivially copyable items");
+
+		struct Buffer
+		{
+			int64_t m_mask;
+			std::unique_ptr<std::atomic<T>[]> m_slots;
+
+			explicit Buffer(int64_t capacity) : m_mask(capacity - 1), m_slots(new std::atomic<T>[capacity])
+			{
+			}
+
+			int64_t capacity() const
+			{
+				return m_mask + 1;
+			}
+
+			T get(int64_t idx) const
+			{
+				return m_slots[idx & m_mask].load(std::memory_order_relaxed);
+			}
+
+			void put(int64_t idx, T item)
+			{
+				m_slots[idx & m_mask].store(item, std::memory_order_relaxed);
+			}
+		};
+
+		alignas(64) std::atomic<int64_t> m_top;//Thieves' end
+		alignas(64) std::atomic<int64_t> m_bottom;//Owner's end
+		std::atomic<Buffer*> m_buffer;
+		//A thief may still be reading from a buffer after the owner has outgrown it, so the old ones live as long as the deque
+		std::vector<std::unique_ptr<Buffer>> m_buffers;
+
+		Buffer* grow(Buffer* buffer, int64_t top, int64_t bottom)
+		{
+			auto bigger = std::make_unique<Buffer>(buffer->capacity() * 2);
+			for (int64_t i = top; i < bottom; i++)
+				bigger->put(i, buffer->get(i));
+
+			buffer = bigger.get();
+			m_buffers.push_back(std::move(bigger));
+			m_buffer.store(buffer, std::memory_order_release);
+			return buffer;
+		}
+
+	public:
+		//'capacity' is rounded up to a power of 2, the deque grows beyond it as needed
+		explicit WorkStealingDeque(size_t capacity = 256)
+		{
+			int64_t actualCapacity = 1;
+			while (actualCapacity < static_cast<int64_t>(capacity))
+				actualCapacity *= 2;
+
+			m_buffers.push_back(std::make_unique<Buffer>(actualCapacity));
+			m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+			m_top.store(0, std::memory_order_relaxed);
+			m_bottom.store(0, std::memory_order_relaxed);
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		//Owner only
+		void push(T item)
+		{
+			int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+			int64_t top = m_top.load(std::memory_order_acquire);
+			Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+			if (bottom - top > buffer->capacity() - 1)
+				buffer = grow(buffer, top, bottom);
+
+			buffer->put(bottom, item);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		//Owner only, takes the most recently pushed item, returns false if the deque is empty
+		bool pop(T& item)
+		{
+			int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = m_top.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = buffer->get(bottom);
+			if (top == bottom)
+			{
+				//Last item, race the thieves for it
+				bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return won;
+			}
+
+			return true;
+		}
+
+		//Any thread, takes the least recently pushed item
+		//Returns false if the deque is empty or another thread took the item first
+		bool steal(T& item)
+		{
+			int64_t top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t bottom = m_bottom.load(std::memory_order_acquire);
+			if (top >= bottom)
+				return false;
+
+			Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+			item = buffer->get(top);
+			return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		//Any thread, only a snapshot as the owner and the thieves may be changing it at the same time
+		bool empty() const
+		{
+			return m_bottom.load(std::memory_order_acquire) <= m_top.load(std::memory_order_acquire);
+		}
+	};
+}
@@ -0,0 +1,348 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "Event.hpp"
+#include "Task.hpp"
+#include "Thread.hpp"
+#include "WorkStealingDeque.hpp"
+
+namespace mtInternalUtils
+{
+	//Pool of threads sharing their load, each worker has its own deque and an idle worker steals from the others
+	//Tasks pushed from a worker go to that worker's own deque, tasks pushed from outside go to a shared queue(the injector)
+	//which every worker takes batches from, so a long task only holds up the worker running it
+	//A worker finding nothing to do anywhere parks on its own Event, and a push wakes one parked worker per task
+	//The deques hold pointers to the tasks, a worker keeps the tasks it has run for the pushes made from it to reuse,
+	//so a pool whose tasks push more tasks(the fork/join case) stops allocating once warmed up
+	class WorkStealingPool
+	{
+		struct Worker
+		{
+			WorkStealingDeque<Task*> m_deque;
+			Event m_event;
+			bool m_idle;//Guarded by m_idleMutex
+			uint64_t m_randomState;//For picking the victims, only touched by the worker itself
+			std::vector<Task*> m_spareTasks;//Empty tasks ready for reuse, only touched by the worker itself till it is joined
+			Thread m_thread;
+
+			explicit Worker(uint64_t seed) : m_idle(false), m_randomState(seed)
+			{
+			}
+		};
+
+		struct Context
+		{
+			WorkStealingPool* m_pool = nullptr;
+			size_t m_index = 0;
+		};
+
+		//Max no. of tasks a worker moves from the injector to its own deque at once, the rest being left for the others
+		static constexpr size_t maxInjectorBatch = 32;
+		//Max no. of spare tasks a worker keeps, the tasks it runs beyond that are freed
+		static constexpr size_t maxSpareTasks = 256;
+
+		std::vector<std::unique_ptr<Worker>> m_workers;
+
+		stdMutex m_injectorMutex;
+		std::deque<Task*> m_injector;
+		std::atomic<size_t> m_injectorSize;
+
+		stdMutex m_idleMutex;
+		std::vector<size_t> m_idleWorkers;
+		std::atomic<size_t> m_numIdle;
+
+		//Tasks pushed but not yet taken by any worker, a worker doesn't park while this is non 0
+		//Incremented before looking at m_terminate, so the workers draining after a kill wait for the pushes that got past it
+		std::atomic<int64_t> m_numQueued;
+		std::atomic<bool> m_terminate;
+
+		static Context& currentContext()
+		{
+			thread_local Context context;
+			return context;
+		}
+
+		static uint64_t nextRandom(uint64_t& state)
+		{
+			//xorshift64
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		void run(size_t idx)
+		{
+			currentContext() = Context{ this, idx };
+			while (true)
+			{
+				if (Task* task = findTask(idx))
+				{
+					m_numQueued.fetch_sub(1);
+					runAndRecycle(idx, task);
+					continue;
+				}
+
+				//Pending tasks are processed even after a kill, same as WorkerThread
+				if (m_terminate && 0 == m_numQueued.load())
+					break;
+
+				park(idx);
+			}
+
+			currentContext() = Context();
+		}
+
+		Task* findTask(size_t idx)
+		{
+			Worker& self = *m_workers[idx];
+			Task* task = nullptr;
+			if (self.m_deque.pop(task) || takeFromInjector(self, task))
+				return task;
+
+			size_t numWorkers = m_workers.size();
+			size_t start = static_cast<size_t>(nextRandom(self.m_randomState) % numWorkers);
+			for (size_t i = 0; i < numWorkers; i++)
+			{
+				size_t victim = (start + i) % numWorkers;
+				if (victim != idx && m_workers[victim]->m_deque.steal(task))
+					return task;
+			}
+
+			return nullptr;
+		}
+
+		void runAndRecycle(size_t idx, Task* task)
+		{
+			//Freed rather than recycled if it throws, the exception ends the thread anyway
+			std::unique_ptr<Task> owner(task);
+			(*task)();
+			//Releases what the callable holds now rather than at its reuse
+			*task = nullptr;
+
+			std::vector<Task*>& spares = m_workers[idx]->m_spareTasks;
+			if (spares.size() < maxSpareTasks)
+				spares.push_back(owner.release());
+		}
+
+		//Pushes from a worker reuse its spare tasks, the others allocate
+		template <class F>
+		Task* newTask(F&& func)
+		{
+			Context& context = currentContext();
+			if (this == context.m_pool)
+			{
+				std::vector<Task*>& spares = m_workers[context.m_index]->m_spareTasks;
+				if (!spares.empty())
+				{
+					Task* task = spares.back();
+					*task = std::forward<F>(func);
+					spares.pop_back();
+					return task;
+				}
+			}
+
+			return new Task(std::forward<F>(func));
+		}
+
+		//Takes a task to run right away plus a fair share of the rest into the worker's own deque, where the others can still steal them
+		bool takeFromInjector(Worker& self, Task*& task)
+		{
+			if (!m_injectorSize.load(std::memory_order_relaxed))
+				return false;
+
+			stdUniqueLock lock(m_injectorMutex);
+			if (m_injector.empty())
+				return false;
+
+			size_t numWorkers = m_workers.size();
+			size_t batchSize = std::min((m_injector.size() + numWorkers - 1) / numWorkers, maxInjectorBatch);
+			task = m_injector.front();
+			m_injector.pop_front();
+			for (size_t i = 1; i < batchSize; i++)
+			{
+				self.m_deque.push(m_injector.front());
+				m_injector.pop_front();
+			}
+
+			m_injectorSize.store(m_injector.size(), std::memory_order_relaxed);
+			return true;
+		}
+
+		void park(size_t idx)
+		{
+			Worker& self = *m_workers[idx];
+			{
+				stdUniqueLock lock(m_idleMutex);
+				self.m_idle = true;
+				m_idleWorkers.push_back(idx);
+				m_numIdle.fetch_add(1);
+			}
+
+			//Registering as idle before looking at m_numQueued pairs with the producers incrementing m_numQueued before
+			//looking at m_numIdle, so either we see the task or its producer sees us
+			if (0 == m_numQueued.load() && !m_terminate)
+				self.m_event.wait();
+
+			stdUniqueLock lock(m_idleMutex);
+			if (self.m_idle)
+			{
+				self.m_idle = false;
+				m_idleWorkers.erase(std::find(m_idleWorkers.begin(), m_idleWorkers.end(), idx));
+				m_numIdle.fetch_sub(1);
+			}
+		}
+
+		void wakeOne()
+		{
+			size_t idx = 0;
+			{
+				stdUniqueLock lock(m_idleMutex);
+				if (m_idleWorkers.empty())
+					return;
+
+				idx = m_idleWorkers.back();
+				m_idleWorkers.pop_back();
+				m_workers[idx]->m_idle = false;
+				m_numIdle.fetch_sub(1);
+			}
+
+			m_workers[idx]->m_event.notify();
+		}
+
+		void enqueue(Task* const* tasks, size_t numTasks)
+		{
+			m_numQueued.fetch_add(static_cast<int64_t>(numTasks));
+			if (m_terminate)
+			{
+				m_numQueued.fetch_sub(static_cast<int64_t>(numTasks));
+				for (size_t i = 0; i < numTasks; i++)
+					delete tasks[i];
+				throw std::runtime_error("The thread pool has been killed and is no longer in a state to process new tasks");
+			}
+
+			Context& context = currentContext();
+			if (this == context.m_pool)
+			{
+				Worker& self = *m_workers[context.m_index];
+				for (size_t i = 0; i < numTasks; i++)
+					self.m_deque.push(tasks[i]);
+			}
+			else
+			{
+				stdUniqueLock lock(m_injectorMutex);
+				m_injector.insert(m_injector.end(), tasks, tasks + numTasks);
+				m_injectorSize.store(m_injector.size(), std::memory_order_relaxed);
+			}
+
+			for (size_t i = 0; i < numTasks && m_numIdle.load(); i++)
+				wakeOne();
+		}
+
+		void deleteLeftovers()
+		{
+			Task* task = nullptr;
+			for (auto& worker : m_workers)
+				while (worker->m_deque.steal(task))
+					delete task;
+
+			for (Task* task : m_injector)
+				delete task;
+			m_injector.clear();
+
+			for (auto& worker : m_workers)
+			{
+				for (Task* task : worker->m_spareTasks)
+					delete task;
+				worker->m_spareTasks.clear();
+			}
+		}
+
+	public:
+		//One worker per entry of 'workerOptions', throws std::system_error if a worker thread can't be started as asked
+		explicit WorkStealingPool(const std::vector<ThreadOptions>& workerOptions)
+		{
+			m_injectorSize = 0;
+			m_numIdle = 0;
+			m_numQueued = 0;
+			m_terminate = false;
+
+			if (workerOptions.empty())
+				throw std::invalid_argument("A thread pool needs at least 1 thread");
+
+			//Every worker has to exist before any of them starts stealing from the others
+			m_workers.reserve(workerOptions.size());
+			for (size_t i = 0; i < workerOptions.size(); i++)
+				m_workers.push_back(std::make_unique<Worker>(0x9E3779B97F4A7C15ull * (i + 1)));
+
+			try
+			{
+				for (size_t i = 0; i < workerOptions.size(); i++)
+					m_workers[i]->m_thread = Thread(workerOptions[i], [this, i]() { run(i); });
+			}
+			catch (...)
+			{
+				kill();
+				throw;
+			}
+		}
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		void push(Task&& task)
+		{
+			Task* ptr = newTask(std::move(task));
+			enqueue(&ptr, 1);
+		}
+
+		template <class F>
+		void emplace(F&& func)
+		{
+			Task* ptr = newTask(std::forward<F>(func));
+			enqueue(&ptr, 1);
+		}
+
+		//The tasks in the range are moved from, pushing from outside the pool takes the injector's lock only once
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			std::vector<Task*> tasks;
+			for (; first != last; ++first)
+				tasks.push_back(newTask(std::move(*first)));
+
+			if (!tasks.empty())
+				enqueue(tasks.data(), tasks.size());
+		}
+
+		size_t numThreads() const
+		{
+			return m_workers.size();
+		}
+
+		//Returns after all the tasks pushed so far have been processed
+		void kill()
+		{
+			if (m_terminate.exchange(true))
+				return;
+
+			for (auto& worker : m_workers)
+				worker->m_event.notify();
+
+			for (auto& worker : m_workers)
+				if (worker->m_thread.joinable())
+					worker->m_thread.join();
+
+			deleteLeftovers();
+		}
+
+		~WorkStealingPool()
+		{
+			kill();
+		}
+	};
+}
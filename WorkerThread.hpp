@@ -1,9 +1,18 @@
 #pragma once
 #include "ConsumerThread.hpp"
+#include "Future.hpp"
+#include "Coroutine.hpp"
 #include "CommonUtils/CommonDefs.hpp"
 
 namespace ULMTTools
 {
+	typedef mtInternalUtils::QueueBackend QueueBackend;
+	typedef mtInternalUtils::OverflowPolicy OverflowPolicy;
+	typedef mtInternalUtils::ConsumerOptions ConsumerOptions;
+	typedef mtInternalUtils::WaitStrategy WaitStrategy;
+	typedef mtInternalUtils::SchedulingPolicy SchedulingPolicy;
+	typedef mtInternalUtils::ThreadOptions ThreadOptions;
+
 	class WorkerThread
 	{
 		friend class ThreadPool;
@@ -13,15 +22,74 @@ namespace ULMTTools
 
 			Consumer m_consumer;
 
+		static ConsumerOptions backendOptions(QueueBackend backend)
+		{
+			ConsumerOptions options;
+			options.backend = backend;
+			return options;
+		}
+
 	public:
-		WorkerThread()
-			:m_consumer([](Task task) {task(); })
+		//QueueBackend::LockFree suits many producers pushing to the same worker, see WorkerThreadTests for a comparison
+		explicit WorkerThread(QueueBackend backend = QueueBackend::LockedVector)
+			:WorkerThread(backendOptions(backend))
+		{
+		}
+
+		//options.capacity bounds the no. of pending tasks, see OverflowPolicy for what happens to pushes beyond it
+		//Beware that with OverflowPolicy::Block, a task pushing to its own full worker blocks forever
+		//threadOptions pins, names and prioritizes the worker thread, throws std::system_error if the OS refuses them
+		explicit WorkerThread(const ConsumerOptions& options, const ThreadOptions& threadOptions = ThreadOptions())
+			:m_consumer([](Task&& task) {task(); }, options, threadOptions)
+		{
+		}
+
+		explicit WorkerThread(const ThreadOptions& threadOptions)
+			:WorkerThread(ConsumerOptions(), threadOptions)
+		{
+		}
+
+		void push(Task&& task)
+		{
+			m_consumer.push(std::move(task));
+		}
+
+		//Constructs the Task right inside the queue, saves a move of the Task compared to push()
+		template <class F>
+		void emplace(F&& func)
 		{
+			m_consumer.emplace(std::forward<F>(func));
 		}
 
-		void push(const Task& task)
+		//Runs 'func' on the worker and returns the future of its result, see Future::then() for chaining more work to it
+		template <class F>
+		auto submit(F&& func)
 		{
-			m_consumer.push(task);
+			return mtInternalUtils::submit(*this, std::forward<F>(func));
+		}
+
+		//co_await worker.schedule() continues the coroutine on this worker
+		mtInternalUtils::ScheduleAwaitable<WorkerThread> schedule()
+		{
+			return mtInternalUtils::ScheduleAwaitable<WorkerThread>(*this);
+		}
+
+		//Never blocks or throws because the worker is full, returns false if the task wasn't queued
+		bool try_push(Task&& task)
+		{
+			return m_consumer.try_push(std::move(task));
+		}
+
+		//Pushes a whole batch with one lock acquisition and at most one wakeup of the worker, the tasks in the range are moved from
+		template <class It>
+		void push_bulk(It first, It last)
+		{
+			m_consumer.push_bulk(first, last);
+		}
+
+		void push_bulk(std::span<Task> tasks)
+		{
+			m_consumer.push_bulk(tasks);
 		}
 
 		//returns number of pending tasks 
@@ -30,6 +98,12 @@ namespace ULMTTools
 			return m_consumer.size();
 		}
 
+		//returns number of tasks discarded because of the overflow policy
+		size_t numDropped()
+		{
+			return m_consumer.numDropped();
+		}
+
 		void kill()
 		{
 			m_consumer.kill();